@@ -0,0 +1,415 @@
+/*
+ * Headless benchmark of the TNM067 modules on synthetic data.
+ *
+ * Every case is run `--repeat` times and written as one JSON object per line with the best and
+ * mean time, the throughput in the unit of the case (interpolations, pixels, voxels or cells and,
+ * for the mesh generators, triangles) and the peak resident memory. On Linux the peak is reset
+ * to the memory in use when a case starts, inputs of the case included, so it is the peak of that
+ * case ("peakMemoryScope":"case"). Elsewhere it is the peak of the process so far
+ * ("peakMemoryScope":"process"), as cases run from small to large it is an upper bound.
+ *
+ * With --trace, the timers and counters of the processors are written to a Chrome trace file.
+ *
+ * Usage: tnm067benchmark [--repeat n] [--threads n] [--output file.jsonl] [--trace file.json]
+ *                        [--quick]
+ */
+
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/datastructures/geometry/mesh.h>
+#include <inviwo/core/datastructures/image/image.h>
+#include <inviwo/core/datastructures/image/layer.h>
+#include <inviwo/core/datastructures/image/layerramprecision.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <inviwo/core/network/networklock.h>
+#include <inviwo/core/network/processornetwork.h>
+#include <inviwo/core/ports/imageport.h>
+#include <inviwo/core/ports/layerport.h>
+#include <inviwo/core/ports/meshport.h>
+#include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/properties/optionproperty.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/tnm067lab1/processors/imageupsampler.h>
+#include <inviwo/tnm067lab1/processors/layertoheightfield.h>
+#include <inviwo/tnm067lab1/util/interpolationmethods.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+#include <inviwo/tnm067lab1/util/profiling.h>
+#include <inviwo/tnm067lab2/processors/hydrogengenerator.h>
+#include <inviwo/tnm067lab3/processors/marchingtetrahedra.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace inviwo;
+
+namespace {
+
+// Results of the interpolation kernels are written here so the calls are not optimized away
+volatile double sink = 0.0;
+
+// Start a new peak for peakMemoryBytes, returns false where the peak can not be reset
+bool resetPeakMemory() {
+#if defined(__linux__)
+    // Writing 5 resets VmHWM to the current resident set size
+    std::ofstream clearRefs{"/proc/self/clear_refs"};
+    clearRefs << "5";
+    clearRefs.close();
+    return !clearRefs.fail();
+#else
+    return false;
+#endif
+}
+
+size_t peakMemoryBytes() {
+#if defined(__linux__)
+    // ru_maxrss is not affected by resetPeakMemory, VmHWM is
+    std::ifstream status{"/proc/self/status"};
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:")) return std::stoull(line.substr(6)) * 1024;
+    }
+#endif
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+struct Options {
+    size_t repeat = 3;
+    size_t threads = 0;
+    std::string output;
+    std::string trace;
+    bool quick = false;
+};
+
+struct Timing {
+    double best = 0.0;
+    double mean = 0.0;
+    size_t peakMemory = 0;
+    // The peak memory is that of this case only, not of the process so far
+    bool peakMemoryPerCase = false;
+};
+
+// Time `repeat` calls of run
+template <typename Run>
+Timing measure(size_t repeat, Run&& run) {
+    Timing timing{std::numeric_limits<double>::max(), 0.0};
+    timing.peakMemoryPerCase = resetPeakMemory();
+    for (size_t i = 0; i < repeat; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        timing.best = std::min(timing.best, elapsed.count());
+        timing.mean += elapsed.count() / static_cast<double>(repeat);
+    }
+    timing.peakMemory = peakMemoryBytes();
+    return timing;
+}
+
+class Report {
+public:
+    explicit Report(std::ostream& out) : out_{out} {}
+
+    void add(std::string_view benchmark, std::string_view name, std::string_view unit,
+             size_t items, const Timing& timing, size_t triangles = 0) {
+        auto line = fmt::format(
+            R"({{"benchmark":"{}","case":"{}","threads":{},"unit":"{}","items":{},)"
+            R"("bestSeconds":{:.6g},"meanSeconds":{:.6g},"itemsPerSecond":{:.6g})",
+            benchmark, name, util::threadCount(), unit, items, timing.best, timing.mean,
+            static_cast<double>(items) / timing.best);
+        if (triangles > 0) {
+            line += fmt::format(R"(,"triangles":{},"trianglesPerSecond":{:.6g})", triangles,
+                                static_cast<double>(triangles) / timing.best);
+        }
+        line += fmt::format(R"(,"peakMemoryBytes":{},"peakMemoryScope":"{}"}})",
+                            timing.peakMemory, timing.peakMemoryPerCase ? "case" : "process");
+        out_ << line << std::endl;
+    }
+
+private:
+    std::ostream& out_;
+};
+
+// Minimal processor used to feed data into the processors under test
+template <typename OutportType>
+class Source : public Processor {
+public:
+    Source() : Processor("source", "Source"), outport_("outport") { addPort(outport_); }
+
+    virtual const ProcessorInfo& getProcessorInfo() const override {
+        static const ProcessorInfo info{"org.inviwo.TNM067BenchmarkSource", "Benchmark Source",
+                                        "TNM067", CodeState::Experimental, Tags::CPU};
+        return info;
+    }
+    virtual void process() override {}
+
+    OutportType outport_;
+};
+
+template <typename T>
+T& property(Processor& processor, std::string_view identifier) {
+    auto* prop = dynamic_cast<T*>(processor.getPropertyByIdentifier(identifier));
+    if (!prop) {
+        throw Exception(fmt::format("{} has no property '{}' of the expected type",
+                                    processor.getIdentifier(), identifier),
+                        IVW_CONTEXT_CUSTOM("TNM067Benchmark"));
+    }
+    return *prop;
+}
+
+template <typename T>
+T& port(Port* untyped) {
+    auto* typed = dynamic_cast<T*>(untyped);
+    if (!typed) {
+        throw Exception("Port of unexpected type", IVW_CONTEXT_CUSTOM("TNM067Benchmark"));
+    }
+    return *typed;
+}
+
+template <typename P>
+P* add(ProcessorNetwork& network, std::string_view identifier) {
+    auto processor = std::make_unique<P>();
+    processor->setIdentifier(identifier);
+    return static_cast<P*>(network.addProcessor(std::move(processor)));
+}
+
+std::shared_ptr<Layer> randomLayer(size2_t dims, std::mt19937& random) {
+    auto ram = std::make_shared<LayerRAMPrecision<float>>(dims);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    auto data = ram->getDataTyped();
+    std::generate(data, data + dims.x * dims.y, [&]() { return dist(random); });
+    return std::make_shared<Layer>(ram);
+}
+
+size_t triangleCount(const Mesh& mesh) {
+    size_t triangles = 0;
+    for (const auto& [meshInfo, indices] : mesh.getIndexBuffers()) {
+        triangles += indices->getSize() / 3;
+    }
+    return triangles;
+}
+
+void benchmarkInterpolation(const Options& options, Report& report, std::mt19937& random) {
+    namespace ip = TNM067::Interpolation;
+
+    const size_t n = options.quick ? 1'000'000 : 20'000'000;
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::array<double, 9> v{};
+    for (auto& value : v) value = dist(random);
+    const std::array<double, 4> v4{v[0], v[1], v[2], v[3]};
+
+    // Positions from a low discrepancy sequence over [0, 1)
+    auto run = [&](std::string_view kernel, auto&& f) {
+        const auto timing = measure(options.repeat, [&]() {
+            double x = 0.0;
+            double sum = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                x += 0.618033988749895;
+                x -= std::floor(x);
+                sum += f(x, 1.0 - x);
+            }
+            sink = sum;
+        });
+        report.add("interpolation", kernel, "interpolations", n, timing);
+    };
+
+    run("linear", [&](double x, double) { return ip::linear(v[0], v[1], x); });
+    run("bilinear", [&](double x, double y) { return ip::bilinear(v4, x, y); });
+    run("quadratic", [&](double x, double) { return ip::quadratic(v[0], v[1], v[2], x); });
+    run("biQuadratic", [&](double x, double y) { return ip::biQuadratic(v, x, y); });
+    run("barycentric", [&](double x, double y) { return ip::barycentric(v4, x, y); });
+}
+
+void benchmarkUpsampler(const Options& options, Report& report, ProcessorNetwork& network,
+                        std::mt19937& random) {
+    auto* source = add<Source<ImageOutport>>(network, "upsamplerSource");
+    auto* upsampler = add<ImageUpsampler>(network, "upsampler");
+    network.addConnection(&source->outport_, upsampler->getInport("inport"));
+
+    const size2_t inputSize = options.quick ? size2_t(128) : size2_t(512);
+    source->outport_.setData(std::make_shared<Image>(randomLayer(inputSize, random)));
+
+    auto& method = property<BaseOptionProperty>(*upsampler, "interpolationMethod");
+    auto& outport = port<ImageOutport>(upsampler->getOutport("outport"));
+
+    for (size_t m = 0; m < method.size(); ++m) {
+        method.setSelectedIndex(m);
+        for (const size_t scale : {2, 4, 8}) {
+            const size2_t outputSize = inputSize * scale;
+            outport.setDimensions(outputSize);
+            const auto timing = measure(options.repeat, [&]() { upsampler->process(); });
+            report.add("upsampler", fmt::format("{} x{}", method.getSelectedIdentifier(), scale),
+                       "pixels", outputSize.x * outputSize.y, timing);
+        }
+    }
+
+    network.removeProcessor(upsampler);
+    network.removeProcessor(source);
+}
+
+std::shared_ptr<const Volume> benchmarkHydrogen(const Options& options, Report& report,
+                                                ProcessorNetwork& network) {
+    auto* hydrogen = add<HydrogenGenerator>(network, "hydrogen");
+    auto& size = property<IntProperty>(*hydrogen, "size_");
+    auto& outport = port<VolumeOutport>(hydrogen->getOutport("volume"));
+
+    const std::vector<int> sizes =
+        options.quick ? std::vector<int>{64, 96} : std::vector<int>{64, 128, 192, 256};
+    for (const int s : sizes) {
+        size.set(s);
+        const auto timing = measure(options.repeat, [&]() { hydrogen->process(); });
+        report.add("hydrogen", fmt::format("{}^3", s), "voxels",
+                   static_cast<size_t>(s) * s * s, timing);
+    }
+
+    // One of the smaller volumes is used as input for the marching tetrahedra benchmark
+    size.set(sizes[sizes.size() / 2 - 1]);
+    hydrogen->process();
+    auto volume = outport.getData();
+    network.removeProcessor(hydrogen);
+    return volume;
+}
+
+void benchmarkMarchingTetrahedra(const Options& options, Report& report,
+                                 ProcessorNetwork& network, std::shared_ptr<const Volume> volume) {
+    auto* source = add<Source<VolumeOutport>>(network, "volumeSource");
+    auto* marching = add<MarchingTetrahedra>(network, "marchingTetrahedra");
+    network.addConnection(&source->outport_, marching->getInport("volume"));
+    source->outport_.setData(volume);
+
+    auto& iso = property<FloatProperty>(*marching, "isoValue");
+    auto& outport = port<MeshOutport>(marching->getOutport("mesh"));
+
+    const auto dims = volume->getDimensions();
+    const size_t cells = (dims.x - 1) * (dims.y - 1) * (dims.z - 1);
+    const auto range = volume->dataMap.valueRange;
+
+    // The hydrogen orbital is concentrated close to 0, so the iso values are spread
+    // logarithmically over the range
+    for (const double fraction : {0.001, 0.01, 0.05, 0.2}) {
+        const double value = range.x + fraction * (range.y - range.x);
+        iso.set(static_cast<float>(value));
+        const auto timing = measure(options.repeat, [&]() { marching->process(); });
+        report.add("marchingTetrahedra", fmt::format("{}^3 iso {:.3g}", dims.x, fraction),
+                   "cells", cells, timing, triangleCount(*outport.getData()));
+    }
+
+    network.removeProcessor(marching);
+    network.removeProcessor(source);
+}
+
+void benchmarkHeightfield(const Options& options, Report& report, ProcessorNetwork& network,
+                          std::mt19937& random) {
+    auto* source = add<Source<LayerOutport>>(network, "layerSource");
+    auto* heightfield = add<LayerToHeightfield>(network, "heightfield");
+    network.addConnection(&source->outport_, heightfield->getInport("layerInport"));
+    auto& outport = port<MeshOutport>(heightfield->getOutport("meshOutport"));
+
+    const std::vector<size_t> sizes =
+        options.quick ? std::vector<size_t>{256} : std::vector<size_t>{512, 1024, 2048};
+    for (const size_t s : sizes) {
+        source->outport_.setData(randomLayer(size2_t(s), random));
+        const auto timing = measure(options.repeat, [&]() { heightfield->process(); });
+        report.add("layerToHeightfield", fmt::format("{}^2", s), "pixels", s * s, timing,
+                   triangleCount(*outport.getData()));
+    }
+
+    network.removeProcessor(heightfield);
+    network.removeProcessor(source);
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw Exception(fmt::format("Missing value for {}", arg),
+                                IVW_CONTEXT_CUSTOM("TNM067Benchmark"));
+            }
+            return argv[++i];
+        };
+        if (arg == "--repeat") {
+            options.repeat = std::max<size_t>(std::stoul(value()), 1);
+        } else if (arg == "--threads") {
+            options.threads = std::stoul(value());
+        } else if (arg == "--output") {
+            options.output = value();
+        } else if (arg == "--trace") {
+            options.trace = value();
+        } else if (arg == "--quick") {
+            options.quick = true;
+        } else {
+            throw Exception(fmt::format("Unknown argument '{}'", arg),
+                            IVW_CONTEXT_CUSTOM("TNM067Benchmark"));
+        }
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        const auto options = parseOptions(argc, argv);
+        util::setThreadCount(options.threads);
+
+        std::ofstream file;
+        if (!options.output.empty()) {
+            file.open(options.output);
+            if (!file) {
+                throw Exception(fmt::format("Unable to open '{}' for writing", options.output),
+                                IVW_CONTEXT_CUSTOM("TNM067Benchmark"));
+            }
+        }
+        Report report{options.output.empty() ? std::cout : file};
+
+        InviwoApplication app(argc, argv, "TNM067 Benchmark");
+        auto& network = *app.getProcessorNetwork();
+        // The processors are called directly, keep the evaluator from also running them
+        NetworkLock lock(&network);
+
+        if (!options.trace.empty()) util::startTrace();
+
+        std::mt19937 random{42};
+        benchmarkInterpolation(options, report, random);
+        benchmarkUpsampler(options, report, network, random);
+        auto volume = benchmarkHydrogen(options, report, network);
+        benchmarkMarchingTetrahedra(options, report, network, volume);
+        benchmarkHeightfield(options, report, network, random);
+
+        if (!options.trace.empty()) util::stopTrace(options.trace);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <modules/opengl/texture/textureutils.h>
 #include <inviwo/tnm067lab1/processors/imageupsampler.h>
 #include <inviwo/tnm067lab1/util/interpolationmethods.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
 #include <inviwo/core/datastructures/image/layerram.h>
 #include <inviwo/core/datastructures/image/layerramprecision.h>
 #include <inviwo/core/util/imageramutils.h>
@@ -30,7 +31,7 @@ void upsample(ImageUpsampler::IntepolationMethod method, const LayerRAMPrecision
         return pos.x + pos.y * outputSize.x;
     };
 
-    util::forEachPixel(outputImage, [&](ivec2 outImageCoords) {
+    auto upsamplePixel = [&](ivec2 outImageCoords) {
         // outImageCoords: Exact pixel coordinates in the output image currently writing to
         // inImageCoords: Relative coordinates of outImageCoords in the input image, might be
         // between pixels
@@ -128,6 +129,15 @@ void upsample(ImageUpsampler::IntepolationMethod method, const LayerRAMPrecision
         }
 
         outPixels[outIndex(outImageCoords)] = finalColor;
+    };
+
+    // Tiles keep the input pixels used by each thread close together
+    util::parallelTiles(outputSize, size2_t(64), [&](size2_t begin, size2_t end) {
+        for (size_t y = begin.y; y < end.y; ++y) {
+            for (size_t x = begin.x; x < end.x; ++x) {
+                upsamplePixel(ivec2(x, y));
+            }
+        }
     });
 }
 
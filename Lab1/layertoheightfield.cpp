@@ -28,6 +28,11 @@
  *********************************************************************************/
 
 #include <inviwo/tnm067lab1/processors/layertoheightfield.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+#include <inviwo/tnm067lab1/util/profiling.h>
+
+#include <algorithm>
+#include <array>
 
 namespace inviwo {
 
@@ -51,7 +56,8 @@ LayerToHeightfield::LayerToHeightfield()
     , colors_(util::make_array<10>([](auto n) {
         return FloatVec4Property{fmt::format("color{}", n + 1), std::format("Color {}", n + 1),
                                  util::ordinalColor(n == 0 ? 1.0f : 0.0f, 0.0f, 0.0f, 1.0f)};
-    })) {
+    }))
+    , logTimings_("logTimings", "Log Timings", false) {
 
     addPorts(layerInport_, meshOutport_);
     addProperty(heightScaleFactor_);
@@ -69,42 +75,50 @@ LayerToHeightfield::LayerToHeightfield()
 
     numColors_.onChange(colorVisibility);
     colorVisibility();
+
+    addProperty(logTimings_);
 }
 
 namespace {
 using HFMesh = TypedMesh<buffertraits::PositionsBuffer, buffertraits::NormalBuffer,
                          buffertraits::ColorsBuffer>;
 
-void addFace(std::vector<HFMesh::Vertex>& vertices, std::vector<unsigned int>& indices,
+// Write the 4 vertices of the face at `vertices` and its 2 triangles at `indices`
+void addFace(HFMesh::Vertex* vertices, unsigned int* indices, unsigned int startID,
              const vec3& c1, const vec3& c2, const vec3& c3, const vec3& c4, const vec3& normal,
              const vec4& color) {
 
-    unsigned int startID = static_cast<unsigned int>(vertices.size());
-    vertices.emplace_back(c1, normal, color);
-    vertices.emplace_back(c2, normal, color);
-    vertices.emplace_back(c3, normal, color);
-    vertices.emplace_back(c4, normal, color);
+    vertices[0] = {c1, normal, color};
+    vertices[1] = {c2, normal, color};
+    vertices[2] = {c3, normal, color};
+    vertices[3] = {c4, normal, color};
 
-    indices.insert(indices.end(),
-                   {startID + 0, startID + 1, startID + 2, startID + 0, startID + 2, startID + 3});
+    const std::array<unsigned int, 6> faceIndices = {
+        startID + 0, startID + 1, startID + 2, startID + 0, startID + 2, startID + 3};
+    std::copy(faceIndices.begin(), faceIndices.end(), indices);
 }
 
 std::shared_ptr<Mesh> buildMesh(const LayerRAM& image, const ScalarToColorMapping& map,
-                                float scaleFactor) {
+                                float scaleFactor, util::ProfileRecord& profile) {
     const auto dims = image.getDimensions();
 
     auto mesh = std::make_shared<HFMesh>();
     auto& indices =
         mesh->addIndexBuffer(DrawType::Triangles, ConnectivityType::None)->getDataContainer();
 
+    // Every pixel is a box of 6 faces with 4 vertices and 6 indices each, at fixed offsets so the
+    // pixels can be written in parallel
+    constexpr size_t verticesPerPixel = 24;
+    constexpr size_t indicesPerPixel = 36;
     std::vector<HFMesh::Vertex> vertices;
-
-    const auto bufferSize = 24 * dims.x * dims.y;
-    indices.reserve(bufferSize);
-    vertices.reserve(bufferSize);
+    {
+        util::ScopedTimer timer{profile, "allocate"};
+        vertices.resize(verticesPerPixel * dims.x * dims.y);
+        indices.resize(indicesPerPixel * dims.x * dims.y);
+    }
 
     const vec2 cellSize = 1.0f / vec2(dims);
-    util::forEachPixel(image, [&](const size2_t& pos) {
+    auto addBox = [&](const size2_t& pos) {
         const vec2 origin2D = vec2(pos) * cellSize;
         const vec3 origin(origin2D.x, 0.0f, origin2D.y);
 
@@ -133,14 +147,37 @@ std::shared_ptr<Mesh> buildMesh(const LayerRAM& image, const ScalarToColorMappin
         constexpr auto front = vec3(0.0f, 0.0f, -1.0f);
         constexpr auto back = vec3(0.0f, 0.0f, 1.0f);
 
-        addFace(vertices, indices, zero, px, pxpz, pz, down, color);       // Bottom face
-        addFace(vertices, indices, py, pypz, pxpypz, pxpy, up, color);     // Top face
-        addFace(vertices, indices, zero, pz, pypz, py, left, color);       // Left face
-        addFace(vertices, indices, px, pxpy, pxpypz, pxpz, right, color);  // Right face
-        addFace(vertices, indices, zero, py, pxpy, px, front, color);      // Front face
-        addFace(vertices, indices, pz, pxpz, pxpypz, pypz, back, color);   // Back face
-    });
+        const size_t pixel = pos.x + pos.y * dims.x;
+        auto v = vertices.data() + verticesPerPixel * pixel;
+        auto i = indices.data() + indicesPerPixel * pixel;
+        const auto id = static_cast<unsigned int>(verticesPerPixel * pixel);
+
+        addFace(v + 0, i + 0, id + 0, zero, px, pxpz, pz, down, color);          // Bottom face
+        addFace(v + 4, i + 6, id + 4, py, pypz, pxpypz, pxpy, up, color);        // Top face
+        addFace(v + 8, i + 12, id + 8, zero, pz, pypz, py, left, color);         // Left face
+        addFace(v + 12, i + 18, id + 12, px, pxpy, pxpypz, pxpz, right, color);  // Right face
+        addFace(v + 16, i + 24, id + 16, zero, py, pxpy, px, front, color);      // Front face
+        addFace(v + 20, i + 30, id + 20, pz, pxpz, pxpypz, pypz, back, color);   // Back face
+    };
+
+    {
+        util::ScopedTimer timer{profile, "emit faces"};
+        util::parallelRange(dims.y, 16, [&](size_t y0, size_t y1) {
+            for (size_t y = y0; y < y1; ++y) {
+                for (size_t x = 0; x < dims.x; ++x) {
+                    addBox(size2_t(x, y));
+                }
+            }
+        });
+    }
+
+    profile.count("pixels", dims.x * dims.y);
+    profile.count("vertices", vertices.size());
+    profile.count("triangles", indices.size() / 3);
+    profile.count("bytesAllocated", vertices.size() * sizeof(HFMesh::Vertex) +
+                                        indices.size() * sizeof(indices[0]));
 
+    util::ScopedTimer timer{profile, "add vertices"};
     mesh->addVertices(vertices);
 
     return mesh;
@@ -156,7 +193,9 @@ void LayerToHeightfield::process() {
         map.addBaseColors(colors_[i].get());
     }
 
-    const auto mesh = buildMesh(*layer, map, heightScaleFactor_);
+    util::ProfileRecord profile{getIdentifier(), logTimings_};
+    const auto mesh = buildMesh(*layer, map, heightScaleFactor_, profile);
+    profile.finish();
 
     meshOutport_.setData(mesh);
 }
@@ -0,0 +1,153 @@
+#include <inviwo/tnm067lab1/util/parallel.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+// Set while a thread runs a chunk, nested calls are then run serially
+thread_local bool insideChunk = false;
+
+struct Job {
+    Job(size_t chunks, const std::function<void(size_t)>& f) : nChunks{chunks}, task{f} {}
+
+    const size_t nChunks;
+    const std::function<void(size_t)>& task;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+class ThreadPool {
+public:
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    ~ThreadPool() { stop(); }
+
+    size_t threadCount() const { return threadCount_; }
+
+    void setThreadCount(size_t n) {
+        if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+        if (n == threadCount_) return;
+        stop();
+        start(n);
+    }
+
+    void run(size_t nChunks, const std::function<void(size_t)>& task) {
+        if (insideChunk || nChunks <= 1 || threadCount_ <= 1) {
+            for (size_t i = 0; i < nChunks; ++i) task(i);
+            return;
+        }
+
+        auto job = std::make_shared<Job>(nChunks, task);
+        {
+            std::lock_guard lock{mutex_};
+            jobs_.push_back(job);
+        }
+        wake_.notify_all();
+
+        // The calling thread helps with its own job, so it always makes progress
+        work(*job);
+
+        {
+            std::unique_lock lock{mutex_};
+            finished_.wait(lock, [&]() { return job->done == job->nChunks; });
+            std::erase(jobs_, job);
+        }
+        if (job->error) std::rethrow_exception(job->error);
+    }
+
+private:
+    ThreadPool() { start(std::max(1u, std::thread::hardware_concurrency())); }
+
+    void start(size_t n) {
+        stop_ = false;
+        threadCount_ = n;
+        for (size_t i = 1; i < n; ++i) {
+            threads_.emplace_back([this]() { loop(); });
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& thread : threads_) thread.join();
+        threads_.clear();
+    }
+
+    void loop() {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock lock{mutex_};
+                wake_.wait(lock, [&]() { return stop_ || !jobs_.empty(); });
+                if (stop_) return;
+                job = jobs_.front();
+                if (job->next >= job->nChunks) {
+                    // Taken by other threads, the owner waits for it to finish
+                    jobs_.pop_front();
+                    continue;
+                }
+            }
+            work(*job);
+        }
+    }
+
+    void work(Job& job) {
+        insideChunk = true;
+        for (size_t i = job.next++; i < job.nChunks; i = job.next++) {
+            try {
+                job.task(i);
+            } catch (...) {
+                std::lock_guard lock{job.errorMutex};
+                if (!job.error) job.error = std::current_exception();
+            }
+            if (++job.done == job.nChunks) {
+                // Lock to not notify between the owner checking done and starting to wait
+                {
+                    std::lock_guard lock{mutex_};
+                }
+                finished_.notify_all();
+            }
+        }
+        insideChunk = false;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> threads_;
+    size_t threadCount_ = 1;
+    bool stop_ = false;
+};
+
+}  // namespace
+
+size_t threadCount() { return ThreadPool::instance().threadCount(); }
+
+void setThreadCount(size_t n) { ThreadPool::instance().setThreadCount(n); }
+
+void detail::runChunks(size_t nChunks, const std::function<void(size_t)>& task) {
+    ThreadPool::instance().run(nChunks, task);
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <inviwo/tnm067lab1/tnm067lab1moduledefine.h>
+#include <inviwo/core/util/glm.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace inviwo {
+
+namespace util {
+
+/*
+ * Shared thread pool for the TNM067 processors. All work is split into chunks that are fixed by
+ * the caller, the calling thread and the pool threads then take chunks until none are left.
+ * Processors running at the same time share the same threads instead of each starting their own,
+ * and calls made from inside a chunk run serially on the current thread.
+ */
+
+// Number of threads used, including the calling thread
+IVW_MODULE_TNM067LAB1_API size_t threadCount();
+// Use n threads, 0 for one per hardware thread. Must not be called while work is running
+IVW_MODULE_TNM067LAB1_API void setThreadCount(size_t n);
+
+namespace detail {
+// Call task(i) for i in [0, nChunks) on the pool, rethrows the first exception of a task
+IVW_MODULE_TNM067LAB1_API void runChunks(size_t nChunks, const std::function<void(size_t)>& task);
+}  // namespace detail
+
+/*
+ * Call f(begin, end) for consecutive ranges of at most `grain` elements covering [0, n)
+ */
+template <typename F>
+void parallelRange(size_t n, size_t grain, F&& f) {
+    grain = std::max<size_t>(grain, 1);
+    detail::runChunks((n + grain - 1) / grain, [&](size_t chunk) {
+        f(chunk * grain, std::min(n, (chunk + 1) * grain));
+    });
+}
+
+/*
+ * Call f(begin, end) for tiles of at most tileSize pixels covering [0, dims), end is exclusive
+ */
+template <typename F>
+void parallelTiles(size2_t dims, size2_t tileSize, F&& f) {
+    tileSize = glm::max(tileSize, size2_t(1));
+    const size2_t nTiles = (dims + tileSize - size2_t(1)) / tileSize;
+    detail::runChunks(nTiles.x * nTiles.y, [&](size_t tile) {
+        const size2_t begin = size2_t(tile % nTiles.x, tile / nTiles.x) * tileSize;
+        f(begin, glm::min(begin + tileSize, dims));
+    });
+}
+
+/*
+ * Compute map(begin, end) for the same ranges as parallelRange and combine the results with
+ * reduce, in order starting from init. The ranges only depend on n and grain, so the result is
+ * the same for any number of threads, also for floating point reductions.
+ */
+template <typename T, typename Map, typename Reduce>
+T parallelReduce(size_t n, size_t grain, T init, Map&& map, Reduce&& reduce) {
+    grain = std::max<size_t>(grain, 1);
+    std::vector<T> partial((n + grain - 1) / grain, init);
+    detail::runChunks(partial.size(), [&](size_t chunk) {
+        partial[chunk] = map(chunk * grain, std::min(n, (chunk + 1) * grain));
+    });
+    for (const auto& value : partial) init = reduce(init, value);
+    return init;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,166 @@
+#include <inviwo/tnm067lab1/util/profiling.h>
+
+#if TNM067_PROFILING
+
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/logcentral.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+// Records finished with ProfileRecord::finish since startTrace
+struct Trace {
+    std::mutex mutex;
+    bool collecting = false;
+    std::vector<std::shared_ptr<const ProfileRecord>> records;
+};
+
+Trace& trace() {
+    static Trace trace;
+    return trace;
+}
+
+double milliseconds(ProfileRecord::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double microseconds(ProfileRecord::Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Names are written as JSON strings
+std::string escape(std::string_view str) {
+    std::string result;
+    for (const char c : str) {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+}  // namespace
+
+ProfileRecord::ProfileRecord(std::string_view name, bool log)
+    : name_{name}, log_{log}, start_{Clock::now()} {}
+
+void ProfileRecord::addEvent(std::string_view name, Clock::time_point start,
+                             Clock::duration duration) {
+    std::lock_guard lock{mutex_};
+    events_.push_back({std::string{name}, start, duration, std::this_thread::get_id()});
+}
+
+void ProfileRecord::count(std::string_view name, std::uint64_t value) {
+    std::lock_guard lock{mutex_};
+    counters_.emplace_back(std::string{name}, value);
+}
+
+std::string ProfileRecord::summary() const {
+    auto str = fmt::format("{}: {:.2f} ms", name_, milliseconds(Clock::now() - start_));
+    for (const auto& event : events_) {
+        str += fmt::format(", {} {:.2f} ms", event.name, milliseconds(event.duration));
+    }
+    for (const auto& [counter, value] : counters_) {
+        str += fmt::format(", {} {}", counter, value);
+    }
+    return str;
+}
+
+void ProfileRecord::finish() {
+    if (log_) LogInfoCustom("TNM067Profiling", summary());
+
+    auto& current = trace();
+    std::lock_guard lock{current.mutex};
+    if (!current.collecting) return;
+
+    // The whole call, last so the counters can be placed at its end in the trace
+    addEvent(name_, start_, Clock::now() - start_);
+    auto copy = std::make_shared<ProfileRecord>(name_);
+    copy->start_ = start_;
+    copy->events_ = events_;
+    copy->counters_ = counters_;
+    current.records.push_back(std::move(copy));
+}
+
+void startTrace() {
+    auto& current = trace();
+    std::lock_guard lock{current.mutex};
+    current.collecting = true;
+    current.records.clear();
+}
+
+void stopTrace(const std::filesystem::path& file) {
+    std::vector<std::shared_ptr<const ProfileRecord>> records;
+    {
+        auto& current = trace();
+        std::lock_guard lock{current.mutex};
+        current.collecting = false;
+        std::swap(records, current.records);
+    }
+
+    std::ofstream out{file};
+    if (!out) {
+        throw Exception(fmt::format("Unable to open '{}' for writing", file.string()),
+                        IVW_CONTEXT_CUSTOM("TNM067Profiling"));
+    }
+
+    // Times are relative to the first record
+    auto origin = ProfileRecord::Clock::time_point::max();
+    for (const auto& record : records) {
+        origin = std::min(origin, record->events().back().start);
+    }
+
+    // Small thread ids in order of appearance
+    std::map<std::thread::id, size_t> threadIds;
+    auto threadId = [&](std::thread::id id) {
+        return threadIds.try_emplace(id, threadIds.size() + 1).first->second;
+    };
+
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    const char* separator = "\n";
+    for (const auto& record : records) {
+        for (const auto& event : record->events()) {
+            out << separator
+                << fmt::format(
+                       R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},)"
+                       R"("pid":1,"tid":{}}})",
+                       escape(event.name), escape(record->name()),
+                       microseconds(event.start - origin), microseconds(event.duration),
+                       threadId(event.thread));
+            separator = ",\n";
+        }
+        if (record->counters().empty()) continue;
+
+        // The counters are reported at the end of the call
+        const auto& call = record->events().back();
+        std::string args;
+        for (const auto& [counter, value] : record->counters()) {
+            args += fmt::format(R"({}"{}":{})", args.empty() ? "" : ",", escape(counter), value);
+        }
+        out << separator
+            << fmt::format(R"({{"name":"{}","ph":"C","ts":{:.3f},"pid":1,"args":{{{}}}}})",
+                           escape(record->name()),
+                           microseconds(call.start + call.duration - origin), args);
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        throw Exception(fmt::format("Failed writing '{}'", file.string()),
+                        IVW_CONTEXT_CUSTOM("TNM067Profiling"));
+    }
+}
+
+}  // namespace util
+
+}  // namespace inviwo
+
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <inviwo/tnm067lab1/tnm067lab1moduledefine.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * Build with TNM067_PROFILING=0 to remove the timers and counters, all the types below are then
+ * empty and their functions do nothing.
+ */
+#ifndef TNM067_PROFILING
+#define TNM067_PROFILING 1
+#endif
+
+namespace inviwo {
+
+namespace util {
+
+inline constexpr bool profilingEnabled = TNM067_PROFILING != 0;
+
+#if TNM067_PROFILING
+
+/*
+ * Timings and counters of one process() call. Scoped timers may be used from several threads.
+ * finish() writes a summary to the log if `log` is set, the processors pass their "Log Timings"
+ * property, and keeps the record while a trace is collected with startTrace. Otherwise nothing
+ * outlives the record.
+ */
+class IVW_MODULE_TNM067LAB1_API ProfileRecord {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        std::string name;
+        Clock::time_point start;
+        Clock::duration duration;
+        std::thread::id thread;
+    };
+
+    explicit ProfileRecord(std::string_view name, bool log = false);
+
+    void addEvent(std::string_view name, Clock::time_point start, Clock::duration duration);
+    void count(std::string_view name, std::uint64_t value);
+
+    const std::string& name() const { return name_; }
+    const std::vector<Event>& events() const { return events_; }
+    const std::vector<std::pair<std::string, std::uint64_t>>& counters() const {
+        return counters_;
+    }
+
+    // One line with the total time, each timer and each counter
+    std::string summary() const;
+    void finish();
+
+private:
+    std::string name_;
+    bool log_;
+    Clock::time_point start_;
+    std::mutex mutex_;
+    std::vector<Event> events_;
+    std::vector<std::pair<std::string, std::uint64_t>> counters_;
+};
+
+class ScopedTimer {
+public:
+    ScopedTimer(ProfileRecord& record, std::string_view name)
+        : record_{record}, name_{name}, start_{ProfileRecord::Clock::now()} {}
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ~ScopedTimer() {
+        record_.addEvent(name_, start_, ProfileRecord::Clock::now() - start_);
+    }
+
+private:
+    ProfileRecord& record_;
+    std::string_view name_;
+    ProfileRecord::Clock::time_point start_;
+};
+
+// Counter for hot loops, keep one per thread or part of the work and add them up afterwards
+class ProfileCounter {
+public:
+    ProfileCounter& operator++() {
+        ++value_;
+        return *this;
+    }
+    ProfileCounter& operator+=(std::uint64_t n) {
+        value_ += n;
+        return *this;
+    }
+    std::uint64_t value() const { return value_; }
+
+private:
+    std::uint64_t value_ = 0;
+};
+
+// Start keeping finished records, dropping any from an earlier trace
+IVW_MODULE_TNM067LAB1_API void startTrace();
+/*
+ * Stop keeping finished records and write the ones since startTrace to `file` in the Chrome trace
+ * event format, viewable in chrome://tracing or Perfetto. Timers become complete events and
+ * counters counter events. The records are dropped afterwards.
+ */
+IVW_MODULE_TNM067LAB1_API void stopTrace(const std::filesystem::path& file);
+
+#else
+
+class ProfileRecord {
+public:
+    explicit ProfileRecord(std::string_view, bool = false) {}
+    template <typename... Args>
+    void count(Args&&...) {}
+    void finish() {}
+};
+
+class ScopedTimer {
+public:
+    ScopedTimer(ProfileRecord&, std::string_view) {}
+};
+
+class ProfileCounter {
+public:
+    ProfileCounter& operator++() { return *this; }
+    ProfileCounter& operator+=(std::uint64_t) { return *this; }
+    std::uint64_t value() const { return 0; }
+};
+
+inline void startTrace() {}
+inline void stopTrace(const std::filesystem::path&) {}
+
+#endif
+
+}  // namespace util
+
+}  // namespace inviwo
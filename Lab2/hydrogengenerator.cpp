@@ -1,11 +1,12 @@
 #include <inviwo/tnm067lab2/processors/hydrogengenerator.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+#include <inviwo/tnm067lab1/util/profiling.h>
 #include <inviwo/core/datastructures/volume/volume.h>
-#include <inviwo/core/util/volumeramutils.h>
-#include <modules/base/algorithm/dataminmax.h>
 #include <inviwo/core/util/indexmapper.h>
 #include <inviwo/core/datastructures/volume/volumeram.h>
-#include <modules/base/algorithm/dataminmax.h>
 
+#include <algorithm>
+#include <limits>
 #include <numbers>
 
 namespace inviwo {
@@ -21,25 +22,60 @@ const ProcessorInfo HydrogenGenerator::processorInfo_{
 const ProcessorInfo& HydrogenGenerator::getProcessorInfo() const { return processorInfo_; }
 
 HydrogenGenerator::HydrogenGenerator()
-    : Processor(), volume_("volume"), size_("size_", "Volume Size", 16, 4, 256) {
+    : Processor()
+    , volume_("volume")
+    , size_("size_", "Volume Size", 16, 4, 256)
+    , logTimings_("logTimings", "Log Timings", false) {
     addPort(volume_);
     addProperty(size_);
+    addProperty(logTimings_);
 }
 
 void HydrogenGenerator::process() {
-    auto ram = std::make_shared<VolumeRAMPrecision<float>>(size3_t(size_));
+    util::ProfileRecord profile{getIdentifier(), logTimings_};
+
+    auto ram = [&]() {
+        util::ScopedTimer timer{profile, "allocate"};
+        return std::make_shared<VolumeRAMPrecision<float>>(size3_t(size_));
+    }();
     auto vol = std::make_shared<Volume>(ram);
 
     auto data = ram->getDataTyped();
-    util::IndexMapper3D index(ram->getDimensions());
-
-    util::forEachVoxel(*ram, [&](const size3_t& pos) {
-        vec3 cartesian = idTOCartesian(pos);
-        data[index(pos)] = static_cast<float>(eval(cartesian));
-    });
-
-    auto minMax = util::volumeMinMax(ram.get());
-    vol->dataMap.dataRange = vol->dataMap.valueRange = dvec2(minMax.first.x, minMax.second.x);
+    const auto dims = ram->getDimensions();
+    util::IndexMapper3D index(dims);
+
+    // Each range of slices is evaluated and returns its min and max value
+    const dvec2 init{std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
+    dvec2 minMax = init;
+    {
+        util::ScopedTimer timer{profile, "evaluate and value range"};
+        minMax = util::parallelReduce(
+            dims.z, 1, init,
+            [&](size_t z0, size_t z1) {
+                dvec2 range = init;
+                for (size3_t pos{0, 0, z0}; pos.z < z1; ++pos.z) {
+                    for (pos.y = 0; pos.y < dims.y; ++pos.y) {
+                        for (pos.x = 0; pos.x < dims.x; ++pos.x) {
+                            vec3 cartesian = idTOCartesian(pos);
+                            const float value = static_cast<float>(eval(cartesian));
+                            data[index(pos)] = value;
+                            range = dvec2(std::min<double>(range.x, value),
+                                          std::max<double>(range.y, value));
+                        }
+                    }
+                }
+                return range;
+            },
+            [](const dvec2& a, const dvec2& b) {
+                return dvec2(std::min(a.x, b.x), std::max(a.y, b.y));
+            });
+    }
+    vol->dataMap.dataRange = vol->dataMap.valueRange = minMax;
+
+    const size_t voxels = dims.x * dims.y * dims.z;
+    profile.count("voxels", voxels);
+    profile.count("bytesAllocated", voxels * sizeof(float));
+    profile.finish();
 
     volume_.setData(vol);
 }
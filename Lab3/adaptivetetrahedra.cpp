@@ -0,0 +1,429 @@
+#include <inviwo/tnm067lab3/util/adaptivetetrahedra.h>
+#include <inviwo/core/datastructures/volume/volumeram.h>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <utility>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+using Edge = std::pair<std::uint64_t, std::uint64_t>;
+
+constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+// The 6 edges of a tetrahedron as pairs of local vertex indices
+constexpr std::array<std::array<size_t, 2>, 6> localEdges{
+    {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}}};
+
+std::uint64_t vertexKey(const ivec3& v) {
+    return (static_cast<std::uint64_t>(v.x) << 42) | (static_cast<std::uint64_t>(v.y) << 21) |
+           static_cast<std::uint64_t>(v.z);
+}
+
+Edge edgeKey(const ivec3& a, const ivec3& b) {
+    const auto ka = vertexKey(a);
+    const auto kb = vertexKey(b);
+    return ka < kb ? Edge{ka, kb} : Edge{kb, ka};
+}
+
+/*
+ * Flat map from an edge to the first and last tetrahedron of the list of tetrahedra around it.
+ * Open addressing with linear probing, entries are removed by shifting the following entries of
+ * the probe sequence back so no tombstones are left. A slot is empty if `first` is none.
+ */
+class EdgeTable {
+public:
+    struct Entry {
+        Edge edge{};
+        std::uint32_t first = none;
+        std::uint32_t last = none;
+    };
+
+    Entry* find(const Edge& edge) {
+        if (slots_.empty()) return nullptr;
+        for (size_t i = slot(edge);; i = next(i)) {
+            if (slots_[i].first == none) return nullptr;
+            if (slots_[i].edge == edge) return &slots_[i];
+        }
+    }
+
+    // Returns the entry of `edge`, a new entry has to be given a `first` tetrahedron right away.
+    // Invalidates pointers to other entries.
+    Entry& insert(const Edge& edge) {
+        if (auto* entry = find(edge)) return *entry;
+        if (2 * (size_ + 1) > slots_.size()) grow();
+        size_t i = slot(edge);
+        while (slots_[i].first != none) i = next(i);
+        ++size_;
+        slots_[i].edge = edge;
+        return slots_[i];
+    }
+
+    void erase(Entry& entry) {
+        auto hole = static_cast<size_t>(&entry - slots_.data());
+        for (size_t i = next(hole); slots_[i].first != none; i = next(i)) {
+            // An entry can fill the hole if the hole lies between its home slot and its slot
+            const size_t home = slot(slots_[i].edge);
+            if (((i - home) & mask()) >= ((i - hole) & mask())) {
+                slots_[hole] = slots_[i];
+                hole = i;
+            }
+        }
+        slots_[hole] = Entry{};
+        --size_;
+    }
+
+private:
+    size_t mask() const { return slots_.size() - 1; }
+    size_t next(size_t i) const { return (i + 1) & mask(); }
+
+    size_t slot(const Edge& edge) const {
+        const auto h = (edge.first ^ (edge.second * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull;
+        return static_cast<size_t>(h ^ (h >> 31)) & mask();
+    }
+
+    void grow() {
+        const auto size = std::max<size_t>(64, 2 * slots_.size());
+        const auto old = std::exchange(slots_, std::vector<Entry>(size));
+        for (const auto& entry : old) {
+            if (entry.first == none) continue;
+            size_t i = slot(entry.edge);
+            while (slots_[i].first != none) i = next(i);
+            slots_[i] = entry;
+        }
+    }
+
+    std::vector<Entry> slots_;
+    size_t size_ = 0;
+};
+
+/*
+ * Vertices x0..x3 and the tag k, the refinement edge is x0-xk. Bisection gives
+ * (x0, ..., xk-1, z, xk+1, ..., x3) and (x1, ..., xk, z, xk+1, ..., x3) with tag k-1 (or 3).
+ */
+struct Tetrahedron {
+    std::array<ivec3, 4> x;
+    int tag = 3;
+    int depth = 0;
+    bool leaf = true;
+};
+
+class AdaptiveRefinement {
+public:
+    AdaptiveRefinement(const VolumeRAM& volume, double iso, double tolerance, int rootSize)
+        : volume_{volume}
+        , dims_{volume.getDimensions()}
+        , iso_{iso}
+        , tolerance_{tolerance}
+        , rootSize_{rootSize}
+        , brickSize_{std::min(rootSize, 8)} {
+        buildMinMax();
+        const auto range = minMax_.back().front();
+        valueRange_ = std::max(static_cast<double>(range.y - range.x),
+                               std::numeric_limits<double>::epsilon());
+
+        // Same split as tetrahedraIds, around the diagonal from (0,1,0) to (1,0,1)
+        const std::array<ivec3, 3> steps{ivec3{rootSize, 0, 0}, ivec3{0, -rootSize, 0},
+                                         ivec3{0, 0, rootSize}};
+        const std::array<std::array<int, 3>, 6> permutations{
+            {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+        const ivec3 cubes = (ivec3(dims_) - 2) / rootSize + 1;
+        for (int z = 0; z < cubes.z; ++z) {
+            for (int y = 0; y < cubes.y; ++y) {
+                for (int x = 0; x < cubes.x; ++x) {
+                    const ivec3 origin = ivec3{x, y, z} * rootSize;
+                    for (const auto& p : permutations) {
+                        Tetrahedron t;
+                        t.x[0] = origin + ivec3{0, rootSize, 0};
+                        for (size_t i = 0; i < 3; ++i) t.x[i + 1] = t.x[i] + steps[p[i]];
+                        add(t);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::array<size3_t, 4>> extract() {
+        for (std::uint32_t i = 0; i < tets_.size(); ++i) {
+            if (tets_[i].leaf && needsRefinement(tets_[i])) refine(i);
+        }
+
+        std::vector<std::array<size3_t, 4>> result;
+        for (const auto& t : tets_) {
+            if (!t.leaf || !inside(t)) continue;
+            size_t above = 0;
+            for (const auto& v : t.x) above += value(v) >= iso_ ? 1 : 0;
+            if (above == 0 || above == 4) continue;
+
+            std::array<size3_t, 4> ids;
+            for (size_t i = 0; i < 4; ++i) ids[i] = size3_t(t.x[i]);
+            const auto det = glm::dot(dvec3(t.x[1] - t.x[0]),
+                                      glm::cross(dvec3(t.x[2] - t.x[0]), dvec3(t.x[3] - t.x[0])));
+            if (det < 0.0) std::swap(ids[2], ids[3]);
+            result.push_back(ids);
+        }
+        return result;
+    }
+
+private:
+    void buildMinMax() {
+        // Level l holds the value range of the aligned cubes of brickSize_ * 2^l cells, cubes
+        // outside of the volume are empty
+        const auto cellDims = ivec3(dims_) - 1;
+        const auto brickDims = (cellDims + brickSize_ - 1) / brickSize_;
+        std::vector<vec2> level(static_cast<size_t>(brickDims.x) * brickDims.y * brickDims.z);
+        for (int z = 0; z < brickDims.z; ++z) {
+            for (int y = 0; y < brickDims.y; ++y) {
+                for (int x = 0; x < brickDims.x; ++x) {
+                    level[x + brickDims.x * (y + brickDims.y * z)] =
+                        voxelRange(ivec3{x, y, z} * brickSize_, brickSize_);
+                }
+            }
+        }
+        minMaxDims_.push_back(brickDims);
+        minMax_.push_back(std::move(level));
+
+        auto maxDim = [](const ivec3& d) { return std::max(d.x, std::max(d.y, d.z)); };
+        while (maxDim(minMaxDims_.back()) > 1) {
+            const auto prevDims = minMaxDims_.back();
+            const auto& prev = minMax_.back();
+            const auto nextDims = (prevDims + 1) / 2;
+            std::vector<vec2> next(static_cast<size_t>(nextDims.x) * nextDims.y * nextDims.z,
+                                   vec2{std::numeric_limits<float>::max(),
+                                        std::numeric_limits<float>::lowest()});
+            for (int z = 0; z < prevDims.z; ++z) {
+                for (int y = 0; y < prevDims.y; ++y) {
+                    for (int x = 0; x < prevDims.x; ++x) {
+                        const auto& r = prev[x + prevDims.x * (y + prevDims.y * z)];
+                        auto& n = next[x / 2 + nextDims.x * (y / 2 + nextDims.y * (z / 2))];
+                        n = vec2{std::min(n.x, r.x), std::max(n.y, r.y)};
+                    }
+                }
+            }
+            minMaxDims_.push_back(nextDims);
+            minMax_.push_back(std::move(next));
+        }
+    }
+
+    // The value range of the voxels of the cube of `size` cells at `origin`, clipped to the volume
+    vec2 voxelRange(const ivec3& origin, int size) const {
+        const ivec3 hi = glm::min(origin + size, ivec3(dims_) - 1);
+        vec2 range{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+        for (int z = origin.z; z <= hi.z; ++z) {
+            for (int y = origin.y; y <= hi.y; ++y) {
+                for (int x = origin.x; x <= hi.x; ++x) {
+                    const auto v = static_cast<float>(volume_.getAsDouble(size3_t(x, y, z)));
+                    range = vec2{std::min(range.x, v), std::max(range.y, v)};
+                }
+            }
+        }
+        return range;
+    }
+
+    // The value range of the smallest aligned cube that contains the tetrahedron. Cubes smaller
+    // than a brick are read from the volume instead of being stored.
+    vec2 cubeRange(const Tetrahedron& t) const {
+        const int size = rootSize_ >> (t.depth / 3);
+        const ivec3 lo = glm::min(glm::min(t.x[0], t.x[1]), glm::min(t.x[2], t.x[3]));
+        const ivec3 origin = (lo / size) * size;
+        if (glm::any(glm::greaterThanEqual(origin, ivec3(dims_) - 1))) {
+            return vec2{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+        }
+        if (size < brickSize_) return voxelRange(origin, size);
+
+        const auto level =
+            static_cast<size_t>(std::countr_zero(static_cast<unsigned>(size / brickSize_)));
+        if (level >= minMax_.size()) return minMax_.back().front();
+        const ivec3 cube = lo / size;
+        const auto& dims = minMaxDims_[level];
+        return minMax_[level][cube.x + dims.x * (cube.y + dims.y * cube.z)];
+    }
+
+    double value(const ivec3& pos) const {
+        return volume_.getAsDouble(size3_t(glm::clamp(pos, ivec3(0), ivec3(dims_) - 1)));
+    }
+
+    // Trilinear interpolation of the volume at a point inside it
+    double sample(const dvec3& pos) const {
+        const ivec3 base = glm::min(ivec3(glm::floor(pos)), ivec3(dims_) - 2);
+        const dvec3 t = pos - dvec3(base);
+        std::array<double, 8> v;
+        for (int corner = 0; corner < 8; ++corner) {
+            v[corner] = value(base + ivec3{corner & 1, (corner >> 1) & 1, (corner >> 2) & 1});
+        }
+        const auto lerp = [](double a, double b, double x) { return a + (b - a) * x; };
+        return lerp(lerp(lerp(v[0], v[1], t.x), lerp(v[2], v[3], t.x), t.y),
+                    lerp(lerp(v[4], v[5], t.x), lerp(v[6], v[7], t.x), t.y), t.z);
+    }
+
+    bool inside(const Tetrahedron& t) const {
+        return std::all_of(t.x.begin(), t.x.end(), [&](const ivec3& v) {
+            return glm::all(glm::greaterThanEqual(v, ivec3(0))) &&
+                   glm::all(glm::lessThan(v, ivec3(dims_)));
+        });
+    }
+
+    static bool canBisect(const Tetrahedron& t) {
+        const auto d = t.x[t.tag] - t.x[0];
+        return d.x % 2 == 0 && d.y % 2 == 0 && d.z % 2 == 0;
+    }
+
+    static Edge refinementEdge(const Tetrahedron& t) { return edgeKey(t.x[0], t.x[t.tag]); }
+
+    bool needsRefinement(const Tetrahedron& t) const {
+        if (!canBisect(t)) return false;
+        const auto range = cubeRange(t);
+        if (iso_ < range.x || iso_ > range.y) return false;
+        if (!inside(t)) return true;
+
+        std::array<double, 4> values;
+        size_t above = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            values[i] = value(t.x[i]);
+            above += values[i] >= iso_ ? 1 : 0;
+        }
+        const bool crossed = above != 0 && above != 4;
+
+        // Refine if a sample is on the other side of the iso value than the linear interpolation
+        // predicts, or if the surface passes through and the linear interpolation is too coarse
+        auto deviates = [&](const dvec3& pos, double linear) {
+            const auto actual = sample(pos);
+            return (actual >= iso_) != (linear >= iso_) ||
+                   (crossed && std::abs(actual - linear) > tolerance_ * valueRange_);
+        };
+        for (size_t i = 0; i < 4; ++i) {
+            for (size_t j = i + 1; j < 4; ++j) {
+                const auto mid = 0.5 * dvec3(t.x[i] + t.x[j]);
+                if (deviates(mid, 0.5 * (values[i] + values[j]))) return true;
+            }
+        }
+        const auto centroid = 0.25 * dvec3(t.x[0] + t.x[1] + t.x[2] + t.x[3]);
+        return deviates(centroid, 0.25 * (values[0] + values[1] + values[2] + values[3]));
+    }
+
+    static size_t localEdge(const Tetrahedron& t, const Edge& edge) {
+        for (size_t e = 0; e < localEdges.size(); ++e) {
+            if (edgeKey(t.x[localEdges[e][0]], t.x[localEdges[e][1]]) == edge) return e;
+        }
+        return localEdges.size();
+    }
+
+    std::uint32_t firstAround(const Edge& edge) {
+        const auto* entry = edges_.find(edge);
+        return entry ? entry->first : none;
+    }
+
+    std::uint32_t nextAround(std::uint32_t id, const Edge& edge) const {
+        return nextAround_[id][localEdge(tets_[id], edge)];
+    }
+
+    void add(const Tetrahedron& t) {
+        const auto id = static_cast<std::uint32_t>(tets_.size());
+        tets_.push_back(t);
+        nextAround_.emplace_back().fill(none);
+        for (const auto& [i, j] : localEdges) {
+            const auto edge = edgeKey(t.x[i], t.x[j]);
+            auto& entry = edges_.insert(edge);
+            if (entry.first == none) {
+                entry.first = id;
+            } else {
+                nextAround_[entry.last][localEdge(tets_[entry.last], edge)] = id;
+            }
+            entry.last = id;
+        }
+    }
+
+    void bisect(std::uint32_t id) {
+        const auto t = tets_[id];
+        tets_[id].leaf = false;
+        for (size_t e = 0; e < localEdges.size(); ++e) {
+            const auto edge = edgeKey(t.x[localEdges[e][0]], t.x[localEdges[e][1]]);
+            auto& entry = *edges_.find(edge);
+            std::uint32_t prev = none;
+            for (auto n = entry.first; n != id; n = nextAround(n, edge)) prev = n;
+
+            const auto next = nextAround_[id][e];
+            if (prev == none) {
+                entry.first = next;
+            } else {
+                nextAround_[prev][localEdge(tets_[prev], edge)] = next;
+            }
+            if (entry.last == id) entry.last = prev;
+            if (entry.first == none) edges_.erase(entry);
+        }
+
+        const int k = t.tag;
+        const ivec3 z = (t.x[0] + t.x[k]) / 2;
+        Tetrahedron a = t;
+        Tetrahedron b = t;
+        a.x[k] = z;
+        for (int i = 0; i < k; ++i) b.x[i] = t.x[i + 1];
+        b.x[k] = z;
+        a.tag = b.tag = k > 1 ? k - 1 : 3;
+        a.depth = b.depth = t.depth + 1;
+        add(a);
+        add(b);
+    }
+
+    // Bisect the refinement edge of tetrahedron `id` and of all its neighbours around that edge.
+    // Neighbours with another refinement edge are refined first until they match.
+    bool refine(std::uint32_t id) {
+        if (!tets_[id].leaf) return true;
+        if (!canBisect(tets_[id])) return false;
+        const auto edge = refinementEdge(tets_[id]);
+
+        for (;;) {
+            auto n = firstAround(edge);
+            while (n != none && refinementEdge(tets_[n]) == edge) n = nextAround(n, edge);
+            if (n == none) break;
+            if (!refine(n)) return false;
+        }
+
+        std::vector<std::uint32_t> around;
+        for (auto n = firstAround(edge); n != none; n = nextAround(n, edge)) around.push_back(n);
+        for (auto n : around) bisect(n);
+        return true;
+    }
+
+    const VolumeRAM& volume_;
+    size3_t dims_;
+    double iso_;
+    double tolerance_;
+    int rootSize_;
+    int brickSize_;
+    double valueRange_ = 1.0;
+
+    std::vector<ivec3> minMaxDims_;
+    std::vector<std::vector<vec2>> minMax_;
+
+    std::vector<Tetrahedron> tets_;
+    // Per tetrahedron and local edge, the next tetrahedron in the list around that edge
+    std::vector<std::array<std::uint32_t, 6>> nextAround_;
+    EdgeTable edges_;
+};
+
+}  // namespace
+
+std::vector<std::array<size3_t, 4>> adaptiveTetrahedra(const VolumeRAM& volume, double iso,
+                                                       double tolerance, size_t maxCellSize) {
+    const auto dims = volume.getDimensions();
+    if (glm::any(glm::lessThan(dims, size3_t(2)))) return {};
+
+    // Root cubes of a power of two size, no larger than needed to cover the volume
+    const auto cells = std::max(dims.x, std::max(dims.y, dims.z)) - 1;
+    const auto rootSize =
+        static_cast<int>(std::min(std::bit_floor(std::max<size_t>(maxCellSize, 1)),
+                                  std::bit_ceil(cells)));
+
+    AdaptiveRefinement refinement{volume, iso, tolerance, rootSize};
+    return refinement.extract();
+}
+
+}  // namespace util
+
+}  // namespace inviwo
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <inviwo/tnm067lab3/tnm067lab3moduledefine.h>
+#include <inviwo/core/util/glm.h>
+
+#include <array>
+#include <vector>
+
+namespace inviwo {
+
+class VolumeRAM;
+
+namespace util {
+
+/*
+ * Adaptive tetrahedral decomposition of a volume for MarchingTetrahedra. The volume is covered by
+ * cubes of maxCellSize voxels which are split into 6 tetrahedra around the same diagonal as
+ * tetrahedraIds. Tetrahedra are bisected (Maubach's newest vertex bisection) as long as the iso
+ * surface may pass through them and, sampled at the edge midpoints and the centroid, the scalar
+ * field either deviates more than `tolerance * value range` from the linear interpolation over
+ * the tetrahedron or crosses the iso value where the corners do not. Neighbours
+ * sharing the bisected edge are always bisected with it, so the resulting mesh is conforming and
+ * the extracted surface is free of cracks between resolutions. The finest tetrahedra span a
+ * single cell.
+ *
+ * @return the leaf tetrahedra inside the volume that are intersected by the iso surface, as voxel
+ * positions ordered to be positively oriented like tetrahedraIds
+ */
+IVW_MODULE_TNM067LAB3_API std::vector<std::array<size3_t, 4>> adaptiveTetrahedra(
+    const VolumeRAM& volume, double iso, double tolerance, size_t maxCellSize = 32);
+
+}  // namespace util
+
+}  // namespace inviwo
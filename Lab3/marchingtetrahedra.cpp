@@ -5,8 +5,16 @@
 #include <inviwo/core/util/assertion.h>
 #include <inviwo/core/network/networklock.h>
 #include <inviwo/tnm067lab1/util/interpolationmethods.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+#include <inviwo/tnm067lab1/util/profiling.h>
+#include <inviwo/tnm067lab3/util/meshsimplification.h>
+#include <inviwo/tnm067lab3/util/adaptivetetrahedra.h>
+#include <inviwo/tnm067lab3/util/tetrahedratables.h>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <tuple>
+#include <vector>
 
 namespace inviwo {
 
@@ -23,12 +31,34 @@ MarchingTetrahedra::MarchingTetrahedra()
     : Processor()
     , volume_("volume")
     , mesh_("mesh")
-    , isoValue_("isoValue", "ISO value", 0.5f, 0.0f, 1.0f) {
+    , isoValue_("isoValue", "ISO value", 0.5f, 0.0f, 1.0f)
+    , simplify_("simplify", "Simplify Mesh", false)
+    , targetRatio_("targetRatio", "Target Triangle Ratio", 0.15f, 0.01f, 1.0f, 0.01f)
+    , maxError_("maxError", "Max Error", 0.001f, 0.0f, 0.05f, 0.0001f)
+    , adaptive_("adaptive", "Adaptive Resolution", false)
+    , adaptiveTolerance_("adaptiveTolerance", "Adaptive Tolerance", 0.01f, 0.0f, 0.2f, 0.001f)
+    , logTimings_("logTimings", "Log Timings", false) {
 
     addPort(volume_);
     addPort(mesh_);
 
     addProperty(isoValue_);
+    addProperty(simplify_);
+    addProperty(targetRatio_);
+    addProperty(maxError_);
+    addProperty(adaptive_);
+    addProperty(adaptiveTolerance_);
+    addProperty(logTimings_);
+
+    auto simplifyVisibility = [&]() {
+        targetRatio_.setVisible(simplify_);
+        maxError_.setVisible(simplify_);
+    };
+    simplify_.onChange(simplifyVisibility);
+    simplifyVisibility();
+
+    adaptive_.onChange([&]() { adaptiveTolerance_.setVisible(adaptive_); });
+    adaptiveTolerance_.setVisible(adaptive_);
 
     isoValue_.setSerializationMode(PropertySerializationMode::All);
 
@@ -50,6 +80,8 @@ MarchingTetrahedra::MarchingTetrahedra()
 
 
 void MarchingTetrahedra::process() {
+    util::ProfileRecord profile{getIdentifier(), logTimings_};
+
     auto volume = volume_.getData()->getRepresentation<VolumeRAM>();
     MeshHelper mesh(volume_.getData());
 
@@ -59,198 +91,210 @@ void MarchingTetrahedra::process() {
 
     util::IndexMapper3D mapVolPosToIndex(dims);
 
-    static constexpr std::array<std::array<size_t, 4>, 6> tetrahedraIds = {
-        {{0, 1, 2, 5}, {1, 3, 2, 5}, {3, 2, 5, 7}, {0, 2, 4, 5}, {6, 4, 2, 5}, {6, 7, 5, 2}}};
-
-    size3_t pos{};
-    for (pos.z = 0; pos.z < dims.z - 1; ++pos.z) {
-        for (pos.y = 0; pos.y < dims.y - 1; ++pos.y) {
-            for (pos.x = 0; pos.x < dims.x - 1; ++pos.x) {
-                // The DataPoint index should be the 1D-index for the DataPoint in the cell
-                // Use volume->getAsDouble to query values from the volume
-                // Spatial position should be between 0 and 1
-
-                // TODO: TASK 2: create a nested for loop to construct the cell
-                Cell c;
-
-                for (size_t z = 0; z <= 1; z++) {
-                    for (size_t y = 0; y <= 1; y++) {
-                        for (size_t x = 0; x <= 1; x++) {
-
-                            vec3 globalPos(x + pos.x, y + pos.y, z + pos.z);
-
-                            auto pstn = calculateDataPointPos(pos, ivec3(x, y, z), dims);
-                            auto val = volume->getAsDouble(globalPos);
-                            auto iiv = mapVolPosToIndex(globalPos);
-
-                            auto vert = calculateDataPointIndexInCell(ivec3(x, y, z));
-
-                            c.dataPoints[vert].pos = pstn;
-                            c.dataPoints[vert].value = val;
-                            c.dataPoints[vert].indexInVolume = iiv;
-
-                        }
-                    }
-                }
-
-                // TODO: TASK 3: Subdivide cell into 6 tetrahedra (hint: use tetrahedraIds)
-                std::vector<Tetrahedra> tetrahedras;
-
-                // fr varje datapoint finns det bara de antal terahedras mjliga som finns i tetrahedrIDS
-
-                for (size_t i = 0; i < tetrahedraIds.size(); i++) { // g igenom tetrahedra ids
-                    Tetrahedra curr{};
-                    for (size_t j = 0; j < tetrahedraIds[0].size(); j++) { // g igenom varje vert i arr gr till datapoint
-                        curr.dataPoints[j] = c.dataPoints[tetrahedraIds[i][j]];
-                    }
-
-                    tetrahedras.push_back(curr);
+    namespace tables = TNM067::TetrahedraTables;
+
+    // The triangles are extracted in parallel into parts of the volume, each part refers to its
+    // own vertices. The parts are then added to the MeshHelper in order, which gives the same
+    // vertices and triangles as extracting everything serially.
+    struct MeshPart {
+        std::vector<std::tuple<vec3, size_t, size_t>> vertices;
+        std::vector<std::array<std::uint32_t, 3>> triangles;
+
+        util::ProfileCounter cellsVisited;
+        util::ProfileCounter activeCells;
+        util::ProfileCounter activeTetrahedra;
+        util::ProfileCounter edgeCacheHits;
+    };
+    auto addPartVertex = [&](MeshPart& part, const DataPoint& a, const DataPoint& b) {
+        part.vertices.emplace_back(linInterp(iso, a, b), a.indexInVolume, b.indexInVolume);
+        return static_cast<std::uint32_t>(part.vertices.size() - 1);
+    };
+
+    // TODO: TASK 4: Calculate case id for each tetrahedra, and add triangles for
+    // each case (use MeshHelper)
+    auto addTriangles = [&](const Tetrahedra& tetrahedra, MeshPart& part) {
+        size_t caseId = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            if (tetrahedra.dataPoints[i].value >= iso) caseId |= size_t{1} << i;
+        }
+        const auto& tetCase = tables::tetrahedronCases[caseId];
+        if (tetCase.nTriangles > 0) ++part.activeTetrahedra;
+
+        std::array<std::uint32_t, 4> edgeVertices{};
+        for (size_t e = 0; e < tetCase.nEdges; ++e) {
+            const auto [a, b] = tetCase.edges[e];
+            const auto& dataPoints = tetrahedra.dataPoints;
+            edgeVertices[e] = addPartVertex(part, dataPoints[a], dataPoints[b]);
+        }
+        for (size_t t = 0; t < tetCase.nTriangles; ++t) {
+            const auto& tri = tetCase.triangles[t];
+            part.triangles.push_back(
+                {edgeVertices[tri[0]], edgeVertices[tri[1]], edgeVertices[tri[2]]});
+        }
+    };
+
+    std::vector<MeshPart> parts;
+    if (adaptive_) {
+        const auto tets = [&]() {
+            util::ScopedTimer timer{profile, "refine"};
+            return util::adaptiveTetrahedra(*volume, iso, adaptiveTolerance_);
+        }();
+        util::ScopedTimer timer{profile, "extract"};
+        constexpr size_t tetsPerPart = 4096;
+        parts.resize((tets.size() + tetsPerPart - 1) / tetsPerPart);
+        util::parallelRange(tets.size(), tetsPerPart, [&](size_t begin, size_t end) {
+            auto& part = parts[begin / tetsPerPart];
+            for (size_t t = begin; t < end; ++t) {
+                const auto& ids = tets[t];
+                Tetrahedra tetrahedra{};
+                for (size_t i = 0; i < 4; ++i) {
+                    tetrahedra.dataPoints[i].pos = calculateDataPointPos(ids[i], ivec3(0), dims);
+                    tetrahedra.dataPoints[i].value = volume->getAsDouble(ids[i]);
+                    tetrahedra.dataPoints[i].indexInVolume = mapVolPosToIndex(ids[i]);
                 }
-
-
-                for (const Tetrahedra& tetrahedra : tetrahedras) {
-                    // TODO: TASK 4: Calculate case id for each tetrahedra, and add triangles for
-                    // each case (use MeshHelper)
-
-                    // Calculate for tetra case index
-                    int caseId = (tetrahedra.dataPoints[0].value >= iso ? 1 : 0)
-                    + (tetrahedra.dataPoints[1].value >= iso ? 2 : 0)
-                    + (tetrahedra.dataPoints[2].value >= iso ? 4 : 0)
-                    + (tetrahedra.dataPoints[3].value >= iso ? 8 : 0);
-                    
-                    // Extract triangles
-                    const auto& l0 = tetrahedra.dataPoints[0];
-                    const auto& l1 = tetrahedra.dataPoints[1];
-                    const auto& l2 = tetrahedra.dataPoints[2];
-                    const auto& l3 = tetrahedra.dataPoints[3];
-
-                    switch (caseId) {
-                        case 0:
-                        case 15: 
-                            break;
-                        case 1:
-                        case 14: { // mellan 0 och 1,2,3
-
-                            auto v1 = addVhelp(iso, l0, l1, mesh);
-                            auto v2 = addVhelp(iso, l0, l2, mesh);
-                            auto v3 = addVhelp(iso, l0, l3, mesh);
-
-                            if (caseId == 1) mesh.addTriangle(v2, v1, v3);
-                            else mesh.addTriangle(v3, v1, v2);
-
-                            break;
-                        }
-                        case 2:
-                        case 13: {
-                            
-                            auto v3 = addVhelp(iso, l1, l3, mesh);
-                            auto v2 = addVhelp(iso, l1, l2, mesh);
-                            auto v0 = addVhelp(iso, l1, l0, mesh);
-
-                            if (caseId == 2)
-                                mesh.addTriangle(v2,v3,v0);
-                            else
-                                mesh.addTriangle(v0,v3,v2);
-
-                            break;
-                        }
-                        case 3:
-                        case 12: {
-
-                            auto v3 = addVhelp(iso, l1, l3, mesh);
-                            auto v2 = addVhelp(iso, l1, l2, mesh);
-                            auto v0 = addVhelp(iso, l0, l3, mesh);
-
-                            if (caseId == 3) mesh.addTriangle(v3,v0,v2);
-                            else mesh.addTriangle(v2,v0,v3);
-
-                            v3 = addVhelp(iso, l0, l3, mesh);
-                            v2 = addVhelp(iso, l0, l2, mesh);
-                            auto v1 = addVhelp(iso, l1, l2, mesh);
-
-                            if (caseId == 12) mesh.addTriangle(v2, v3, v1);
-                            else mesh.addTriangle(v1, v3, v2);
-
-                            break;
-                        }
-                        case 4:
-                        case 11: {
-
-                            auto v3 = addVhelp(iso, l2, l3, mesh);
-                            auto v0 = addVhelp(iso, l2, l0, mesh);
-                            auto v1 = addVhelp(iso, l2, l1, mesh);
-
-                            if (caseId == 4) mesh.addTriangle(v1, v0, v3);
-                            else mesh.addTriangle(v3, v0, v1);
-
-                            break;
+                addTriangles(tetrahedra, part);
+            }
+        });
+    } else {
+        // One part per z-slice of cells
+        util::ScopedTimer timer{profile, "extract"};
+        parts.resize(dims.z - 1);
+        util::parallelRange(dims.z - 1, 1, [&](size_t z0, size_t z1) {
+            size3_t pos{};
+            for (pos.z = z0; pos.z < z1; ++pos.z) {
+                auto& part = parts[pos.z];
+                for (pos.y = 0; pos.y < dims.y - 1; ++pos.y) {
+                    for (pos.x = 0; pos.x < dims.x - 1; ++pos.x) {
+                        // The DataPoint index should be the 1D-index for the DataPoint in the cell
+                        // Use volume->getAsDouble to query values from the volume
+                        // Spatial position should be between 0 and 1
+
+                        // TODO: TASK 2: create a nested for loop to construct the cell
+                        ++part.cellsVisited;
+                        Cell c;
+
+                        for (size_t z = 0; z <= 1; z++) {
+                            for (size_t y = 0; y <= 1; y++) {
+                                for (size_t x = 0; x <= 1; x++) {
+
+                                    vec3 globalPos(x + pos.x, y + pos.y, z + pos.z);
+
+                                    auto pstn = calculateDataPointPos(pos, ivec3(x, y, z), dims);
+                                    auto val = volume->getAsDouble(globalPos);
+                                    auto iiv = mapVolPosToIndex(globalPos);
+
+                                    auto vert = calculateDataPointIndexInCell(ivec3(x, y, z));
+
+                                    c.dataPoints[vert].pos = pstn;
+                                    c.dataPoints[vert].value = val;
+                                    c.dataPoints[vert].indexInVolume = iiv;
+
+                                }
+                            }
                         }
-                        case 5:
-                        case 10: {
-
-                            auto v1 = addVhelp(iso, l0, l1, mesh);
-                            auto v2 = addVhelp(iso, l2, l1, mesh);
-                            auto v3 = addVhelp(iso, l0, l3, mesh);
-
-                            if (caseId == 5)
-                                mesh.addTriangle(v1,v3,v2);
-                            else
-                                mesh.addTriangle(v2,v3,v1);
 
-                            v1 = addVhelp(iso, l0, l3, mesh);
-                            v2 = addVhelp(iso, l2, l3, mesh);
-                            v3 = addVhelp(iso, l2, l1, mesh);
-
-                            if (caseId == 5)
-                                mesh.addTriangle(v1,v2,v3);
-                            else
-                                mesh.addTriangle(v3,v2,v1);
-
-                            break;
+                        // TODO: TASK 3: Subdivide cell into 6 tetrahedra (hint: use tetrahedraIds)
+                        // The case of each tetrahedron is read from the corners of the cell, and
+                        // cells that are entirely above or below the iso value are skipped
+                        std::uint8_t above = 0;
+                        for (size_t i = 0; i < 8; ++i) {
+                            if (c.dataPoints[i].value >= iso) {
+                                above |= static_cast<std::uint8_t>(1 << i);
+                            }
                         }
-                        case 6:
-                        case 9: {
-
-                            auto v0 = addVhelp(iso, l1, l0, mesh);
-                            auto v3 = addVhelp(iso, l1, l3, mesh);
-                            auto v2 = addVhelp(iso, l2, l0, mesh);
-
-                            if (caseId == 9)
-                                mesh.addTriangle(v0,v3,v2);
-                            else
-                                mesh.addTriangle(v2, v3, v0);
-
-                            auto v20 = addVhelp(iso, l2, l0, mesh);
-                            auto v23 = addVhelp(iso, l2, l3, mesh);
-                            auto v13 = addVhelp(iso, l1, l3, mesh);
-
-                            if (caseId == 6)
-                                mesh.addTriangle(v20,v23,v13);
-                            else
-                                mesh.addTriangle(v13,v23,v20);
-                            break;
-                        }
-                        case 7:
-                        case 8: {
-
-                            auto v2 = addVhelp(iso, l3, l2, mesh);
-                            auto v1 = addVhelp(iso, l3, l1, mesh);
-                            auto v0 = addVhelp(iso, l3, l0, mesh);
-
-                            if (caseId == 8)
-                                mesh.addTriangle(v1, v2, v0);
-                            else
-                                mesh.addTriangle(v0, v2, v1);
-
-                            break;
+                        if (above == 0 || above == 0xff) continue;
+                        ++part.activeCells;
+
+                        // Edges are shared between the tetrahedra of the cell, look each one up
+                        // once
+                        std::array<std::uint32_t, 64> edgeVertex;
+                        edgeVertex.fill(std::numeric_limits<std::uint32_t>::max());
+
+                        for (size_t t = 0; t < tables::tetrahedraIds.size(); ++t) {
+                            const auto& tetCase = tables::cellCases[t][tables::caseId(above, t)];
+                            if (tetCase.nTriangles > 0) ++part.activeTetrahedra;
+
+                            std::array<std::uint32_t, 4> edgeVertices{};
+                            for (size_t e = 0; e < tetCase.nEdges; ++e) {
+                                const auto [a, b] = tetCase.edges[e];
+                                auto& vertex = edgeVertex[std::min(a, b) * 8 + std::max(a, b)];
+                                if (vertex == std::numeric_limits<std::uint32_t>::max()) {
+                                    vertex = addPartVertex(part, c.dataPoints[a], c.dataPoints[b]);
+                                } else {
+                                    ++part.edgeCacheHits;
+                                }
+                                edgeVertices[e] = vertex;
+                            }
+                            for (size_t i = 0; i < tetCase.nTriangles; ++i) {
+                                const auto& tri = tetCase.triangles[i];
+                                part.triangles.push_back({edgeVertices[tri[0]],
+                                                          edgeVertices[tri[1]],
+                                                          edgeVertices[tri[2]]});
+                            }
                         }
                     }
                 }
             }
+        });
+    }
+
+    // New vertices get the next id, so the number of unique vertices is the largest id + 1
+    std::uint32_t uniqueVertices = 0;
+    {
+        util::ScopedTimer timer{profile, "deduplicate"};
+        for (const auto& part : parts) {
+            std::vector<std::uint32_t> ids;
+            ids.reserve(part.vertices.size());
+            for (const auto& [pos, i, j] : part.vertices) {
+                ids.push_back(mesh.addVertex(pos, i, j));
+                uniqueVertices = std::max(uniqueVertices, ids.back() + 1);
+            }
+            for (const auto& tri : part.triangles) {
+                mesh.addTriangle(ids[tri[0]], ids[tri[1]], ids[tri[2]]);
+            }
+        }
+    }
+
+    std::shared_ptr<BasicMesh> basicMesh = [&]() {
+        util::ScopedTimer timer{profile, "normals"};
+        return mesh.toBasicMesh();
+    }();
+    if (simplify_) {
+        util::ScopedTimer timer{profile, "simplify"};
+        util::MeshSimplificationSettings settings;
+        settings.targetRatio = targetRatio_;
+        settings.maxError = maxError_;
+        basicMesh = util::simplifyMesh(*basicMesh, settings);
+    }
+
+    if constexpr (util::profilingEnabled) {
+        util::ProfileCounter cellsVisited, activeCells, activeTetrahedra, edgeCacheHits;
+        size_t edgeVertices = 0;
+        size_t triangles = 0;
+        size_t partBytes = 0;
+        for (const auto& part : parts) {
+            cellsVisited += part.cellsVisited.value();
+            activeCells += part.activeCells.value();
+            activeTetrahedra += part.activeTetrahedra.value();
+            edgeCacheHits += part.edgeCacheHits.value();
+            edgeVertices += part.vertices.size();
+            triangles += part.triangles.size();
+            partBytes += part.vertices.capacity() * sizeof(part.vertices[0]) +
+                         part.triangles.capacity() * sizeof(part.triangles[0]);
         }
+        profile.count("cellsVisited", cellsVisited.value());
+        profile.count("activeCells", activeCells.value());
+        profile.count("activeTetrahedra", activeTetrahedra.value());
+        profile.count("edgeCacheHits", edgeCacheHits.value());
+        profile.count("edgeVertices", edgeVertices);
+        profile.count("uniqueVertices", uniqueVertices);
+        profile.count("triangles", triangles);
+        profile.count("bytesAllocated", partBytes + uniqueVertices * sizeof(BasicMesh::Vertex) +
+                                            triangles * 3 * sizeof(std::uint32_t));
     }
+    profile.finish();
 
-    mesh_.setData(mesh.toBasicMesh());
+    mesh_.setData(basicMesh);
 }
 
 vec3 MarchingTetrahedra::linInterp(const float iso, const DataPoint& A, const DataPoint& B) {
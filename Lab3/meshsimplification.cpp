@@ -0,0 +1,422 @@
+#include <inviwo/tnm067lab3/util/meshsimplification.h>
+#include <inviwo/core/datastructures/buffer/bufferram.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+
+namespace inviwo {
+
+namespace util {
+
+namespace {
+
+// Symmetric 4x4 plane quadric, stored as its upper triangle, and the total area of the planes
+struct Quadric {
+    std::array<double, 10> q{};
+    double area = 0.0;
+
+    static Quadric plane(const dvec3& n, double d, double area) {
+        Quadric r;
+        // clang-format off
+        r.q = {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,
+                          n.y * n.y, n.y * n.z, n.y * d,
+                                     n.z * n.z, n.z * d,
+                                                d * d};
+        // clang-format on
+        for (auto& v : r.q) v *= area;
+        r.area = area;
+        return r;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        for (size_t i = 0; i < q.size(); ++i) q[i] += other.q[i];
+        area += other.area;
+        return *this;
+    }
+    friend Quadric operator+(Quadric a, const Quadric& b) { return a += b; }
+
+    // Area weighted sum of squared distances to the planes
+    double error(const dvec3& p) const {
+        return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z +
+               2.0 * q[3] * p.x + q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y +
+               q[7] * p.z * p.z + 2.0 * q[8] * p.z + q[9];
+    }
+
+    std::optional<dvec3> minimizer() const {
+        const dmat3 a{q[0], q[1], q[2], q[1], q[4], q[5], q[2], q[5], q[7]};
+        const double scale = (q[0] + q[4] + q[7]) / 3.0;
+        const double det = glm::determinant(a);
+        if (scale <= 0.0 || std::abs(det) < 1e-6 * scale * scale * scale) return std::nullopt;
+        return -(glm::inverse(a) * dvec3(q[3], q[6], q[8]));
+    }
+};
+
+struct Collapse {
+    double cost;
+    std::uint32_t u;  // kept vertex
+    std::uint32_t v;  // removed vertex
+    std::uint32_t stampU;
+    std::uint32_t stampV;
+    dvec3 pos;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+using Face = std::array<std::uint32_t, 3>;
+
+class Simplifier {
+public:
+    Simplifier(std::vector<dvec3> positions, std::vector<Face> faces)
+        : positions_{std::move(positions)}
+        , faces_{std::move(faces)}
+        , faceAlive_(faces_.size(), 1)
+        , vertexFaces_(positions_.size())
+        , quadrics_(positions_.size())
+        , removed_(positions_.size(), 0)
+        , fixed_(positions_.size(), 0)
+        , stamps_(positions_.size(), 0)
+        , blockOf_(positions_.size(), 0)
+        , locked_(positions_.size(), 0)
+        , aliveFaces_{faces_.size()} {
+
+        std::unordered_map<std::uint64_t, int> edgeUse;
+        for (std::uint32_t f = 0; f < faces_.size(); ++f) {
+            const auto& face = faces_[f];
+            const auto n = faceNormal(face);
+            const double area = 0.5 * glm::length(n);
+            if (area > 0.0) {
+                const dvec3 unit = n / (2.0 * area);
+                const auto quadric =
+                    Quadric::plane(unit, -glm::dot(unit, positions_[face[0]]), area);
+                for (auto i : face) quadrics_[i] += quadric;
+            }
+            for (size_t i = 0; i < 3; ++i) {
+                vertexFaces_[face[i]].push_back(f);
+                ++edgeUse[edgeKey(face[i], face[(i + 1) % 3])];
+            }
+        }
+        // Vertices on open boundaries are kept in place to not shrink the surface
+        for (const auto& [key, count] : edgeUse) {
+            if (count == 1) {
+                fixed_[key >> 32] = 1;
+                fixed_[key & 0xffffffff] = 1;
+            }
+        }
+    }
+
+    size_t aliveFaces() const { return aliveFaces_; }
+
+    void pass(const MeshSimplificationSettings& settings, size_t targetFaces, bool shifted) {
+        const auto blocks = assignBlocks(std::max<size_t>(settings.blocksPerAxis, 1), shifted);
+
+        // Faces spanning several blocks are not simplified in this pass, the faces inside the
+        // blocks are reduced enough to reach the target including them
+        size_t spanning = 0;
+        for (size_t f = 0; f < faces_.size(); ++f) {
+            const auto& face = faces_[f];
+            const auto block = blockOf_[face[0]];
+            if (faceAlive_[f] && (blockOf_[face[1]] != block || blockOf_[face[2]] != block)) {
+                ++spanning;
+            }
+        }
+        const double ratio =
+            targetFaces > spanning
+                ? static_cast<double>(targetFaces - spanning) /
+                      static_cast<double>(std::max<size_t>(aliveFaces_ - spanning, 1))
+                : 0.0;
+        const double maxError = static_cast<double>(settings.maxError) * settings.maxError;
+
+        aliveFaces_ -= util::parallelReduce(
+            blocks.size(), 1, size_t{0},
+            [&](size_t b, size_t) { return simplifyBlock(blocks[b], ratio, maxError); },
+            std::plus<>{});
+    }
+
+    std::shared_ptr<BasicMesh> toBasicMesh(const std::vector<vec4>& colors) const {
+        constexpr auto unused = std::numeric_limits<std::uint32_t>::max();
+        std::vector<std::uint32_t> newIndex(positions_.size(), unused);
+        std::vector<BasicMesh::Vertex> vertices;
+        auto mesh = std::make_shared<BasicMesh>();
+        auto& indices =
+            mesh->addIndexBuffer(DrawType::Triangles, ConnectivityType::None)->getDataContainer();
+        indices.reserve(3 * aliveFaces_);
+
+        for (size_t f = 0; f < faces_.size(); ++f) {
+            if (!faceAlive_[f]) continue;
+            const auto n = vec3(faceNormal(faces_[f]));
+            for (auto i : faces_[f]) {
+                if (newIndex[i] == unused) {
+                    newIndex[i] = static_cast<std::uint32_t>(vertices.size());
+                    const vec3 pos{positions_[i]};
+                    vertices.push_back({pos, vec3(0.0f), pos, colors[i]});
+                }
+                std::get<1>(vertices[newIndex[i]]) += n;
+                indices.push_back(newIndex[i]);
+            }
+        }
+        for (auto& vertex : vertices) {
+            std::get<1>(vertex) = glm::normalize(std::get<1>(vertex));
+        }
+        mesh->addVertices(vertices);
+        return mesh;
+    }
+
+private:
+    static std::uint64_t edgeKey(std::uint32_t a, std::uint32_t b) {
+        if (b < a) std::swap(a, b);
+        return (static_cast<std::uint64_t>(a) << 32) | b;
+    }
+
+    // Twice the area times the unit normal
+    dvec3 faceNormal(const Face& face) const {
+        const auto& a = positions_[face[0]];
+        return glm::cross(positions_[face[1]] - a, positions_[face[2]] - a);
+    }
+
+    std::vector<std::vector<std::uint32_t>> assignBlocks(size_t n, bool shifted) {
+        dvec3 lo{std::numeric_limits<double>::max()};
+        dvec3 hi{std::numeric_limits<double>::lowest()};
+        for (size_t i = 0; i < positions_.size(); ++i) {
+            if (removed_[i]) continue;
+            lo = glm::min(lo, positions_[i]);
+            hi = glm::max(hi, positions_[i]);
+        }
+        // Cubic blocks, so flat meshes are not cut into thin slabs along their short axis
+        const dvec3 extent = hi - lo;
+        const dvec3 blockSize{std::max({extent.x, extent.y, extent.z, 1e-12}) /
+                              static_cast<double>(n)};
+        const dvec3 offset = shifted ? 0.5 * blockSize : dvec3(0.0);
+        const size_t cells = shifted ? n + 1 : n;
+
+        std::vector<std::vector<std::uint32_t>> blocks(cells * cells * cells);
+        for (std::uint32_t i = 0; i < positions_.size(); ++i) {
+            if (removed_[i]) continue;
+            const auto cell = glm::clamp(size3_t((positions_[i] - lo + offset) / blockSize),
+                                         size3_t(0), size3_t(cells - 1));
+            blockOf_[i] = static_cast<std::uint32_t>(cell.x + cells * (cell.y + cells * cell.z));
+            blocks[blockOf_[i]].push_back(i);
+        }
+        // A vertex sharing a face with another block belongs to two threads, leave it in place
+        for (std::uint32_t i = 0; i < positions_.size(); ++i) {
+            if (removed_[i]) continue;
+            locked_[i] = fixed_[i];
+            for (auto f : vertexFaces_[i]) {
+                for (auto j : faces_[f]) {
+                    if (blockOf_[j] != blockOf_[i]) locked_[i] = 1;
+                }
+            }
+        }
+        return blocks;
+    }
+
+    std::vector<std::uint32_t> neighbors(std::uint32_t u) const {
+        std::vector<std::uint32_t> result;
+        for (auto f : vertexFaces_[u]) {
+            for (auto j : faces_[f]) {
+                if (j != u) result.push_back(j);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    std::optional<Collapse> candidate(std::uint32_t u, std::uint32_t v) const {
+        if (locked_[u] && locked_[v]) return std::nullopt;
+        // The removed vertex v has to be free, a locked u keeps its position
+        if (locked_[v]) std::swap(u, v);
+
+        const auto quadric = quadrics_[u] + quadrics_[v];
+        dvec3 pos = positions_[u];
+        if (!locked_[u]) {
+            const auto mid = 0.5 * (positions_[u] + positions_[v]);
+            const auto edgeLength = glm::distance(positions_[u], positions_[v]);
+            const auto optimal = quadric.minimizer();
+            if (optimal && glm::distance(*optimal, mid) <= edgeLength) {
+                pos = *optimal;
+            } else {
+                pos = mid;
+                for (const auto& p : {positions_[u], positions_[v]}) {
+                    if (quadric.error(p) < quadric.error(pos)) pos = p;
+                }
+            }
+        }
+        const double cost = std::max(quadric.error(pos), 0.0) / std::max(quadric.area, 1e-30);
+        return Collapse{cost, u, v, stamps_[u], stamps_[v], pos};
+    }
+
+    bool isValid(const Collapse& c) const {
+        // Link condition, the only common neighbors may be the opposite vertices of the faces
+        // shared by u and v, otherwise the collapse makes the surface non-manifold
+        const auto nu = neighbors(c.u);
+        const auto nv = neighbors(c.v);
+        std::vector<std::uint32_t> common;
+        std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(),
+                              std::back_inserter(common));
+        size_t shared = 0;
+        for (auto f : vertexFaces_[c.u]) {
+            const auto& face = faces_[f];
+            if (std::find(face.begin(), face.end(), c.v) != face.end()) ++shared;
+        }
+        if (common.size() != shared) return false;
+
+        // Reject collapses that flip or degenerate any of the remaining faces
+        auto moved = [&](std::uint32_t i) { return i == c.u || i == c.v ? c.pos : positions_[i]; };
+        for (auto w : {c.u, c.v}) {
+            for (auto f : vertexFaces_[w]) {
+                const auto& face = faces_[f];
+                if (std::find(face.begin(), face.end(), c.u) != face.end() &&
+                    std::find(face.begin(), face.end(), c.v) != face.end()) {
+                    continue;
+                }
+                const auto before = faceNormal(face);
+                const auto after = glm::cross(moved(face[1]) - moved(face[0]),
+                                              moved(face[2]) - moved(face[0]));
+                if (glm::dot(before, after) <= 0.2 * glm::length(before) * glm::length(after)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t collapse(const Collapse& c) {
+        size_t removedFaces = 0;
+        // A locked u keeps its position and is read by the neighboring blocks, so it is not written
+        if (!locked_[c.u]) positions_[c.u] = c.pos;
+        quadrics_[c.u] += quadrics_[c.v];
+        removed_[c.v] = 1;
+        ++stamps_[c.u];
+        ++stamps_[c.v];
+
+        for (auto f : vertexFaces_[c.v]) {
+            auto& face = faces_[f];
+            if (std::find(face.begin(), face.end(), c.u) != face.end()) {
+                faceAlive_[f] = 0;
+                ++removedFaces;
+                for (auto i : face) {
+                    if (i != c.v) std::erase(vertexFaces_[i], f);
+                }
+            } else {
+                std::replace(face.begin(), face.end(), c.v, c.u);
+                vertexFaces_[c.u].push_back(f);
+            }
+        }
+        vertexFaces_[c.v].clear();
+        return removedFaces;
+    }
+
+    size_t simplifyBlock(const std::vector<std::uint32_t>& vertices, double ratio,
+                         double maxError) {
+        const auto block = vertices.empty() ? 0 : blockOf_[vertices.front()];
+        size_t blockFaces = 0;
+        for (auto u : vertices) {
+            for (auto f : vertexFaces_[u]) {
+                // count each face once, from its first vertex
+                if (faces_[f][0] == u &&
+                    std::all_of(faces_[f].begin(), faces_[f].end(),
+                                [&](auto j) { return blockOf_[j] == block; })) {
+                    ++blockFaces;
+                }
+            }
+        }
+        const auto target = static_cast<size_t>(static_cast<double>(blockFaces) * ratio);
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+        auto push = [&](std::uint32_t u) {
+            for (auto v : neighbors(u)) {
+                if (locked_[u] && locked_[v]) continue;
+                if (auto c = candidate(u, v)) queue.push(*c);
+            }
+        };
+        for (auto u : vertices) {
+            if (!locked_[u]) push(u);
+        }
+
+        size_t removedFaces = 0;
+        while (!queue.empty() && blockFaces - removedFaces > target) {
+            const auto c = queue.top();
+            queue.pop();
+            if (removed_[c.u] || removed_[c.v] || stamps_[c.u] != c.stampU ||
+                stamps_[c.v] != c.stampV) {
+                continue;
+            }
+            if (c.cost > maxError) break;
+            if (!isValid(c)) continue;
+
+            removedFaces += collapse(c);
+            push(c.u);
+        }
+        return removedFaces;
+    }
+
+    std::vector<dvec3> positions_;
+    std::vector<Face> faces_;
+    std::vector<char> faceAlive_;
+    std::vector<std::vector<std::uint32_t>> vertexFaces_;
+    std::vector<Quadric> quadrics_;
+    std::vector<char> removed_;
+    std::vector<char> fixed_;
+    std::vector<std::uint32_t> stamps_;
+    std::vector<std::uint32_t> blockOf_;
+    std::vector<char> locked_;
+    size_t aliveFaces_;
+};
+
+}  // namespace
+
+std::shared_ptr<BasicMesh> simplifyMesh(const BasicMesh& mesh,
+                                        const MeshSimplificationSettings& settings) {
+    const auto positionBuffer = mesh.findBuffer(BufferType::PositionAttrib).first;
+    const auto colorBuffer = mesh.findBuffer(BufferType::ColorAttrib).first;
+    if (!positionBuffer) return std::make_shared<BasicMesh>(mesh);
+
+    const auto positionRAM = positionBuffer->getRepresentation<BufferRAM>();
+    std::vector<dvec3> positions(positionRAM->getSize());
+    std::vector<vec4> colors(positions.size(), vec4(0.7f, 0.7f, 0.7f, 1.0f));
+    for (size_t i = 0; i < positions.size(); ++i) {
+        positions[i] = positionRAM->getAsDVec3(i);
+    }
+    if (colorBuffer) {
+        const auto colorRAM = colorBuffer->getRepresentation<BufferRAM>();
+        for (size_t i = 0; i < colors.size(); ++i) {
+            colors[i] = vec4(colorRAM->getAsDVec4(i));
+        }
+    }
+
+    std::vector<Face> faces;
+    for (const auto& [info, indexBuffer] : mesh.getIndexBuffers()) {
+        if (info.dt != DrawType::Triangles || info.ct != ConnectivityType::None) continue;
+        const auto& indices = indexBuffer->getRAMRepresentation()->getDataContainer();
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            if (indices[i] == indices[i + 1] || indices[i] == indices[i + 2] ||
+                indices[i + 1] == indices[i + 2]) {
+                continue;
+            }
+            faces.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        }
+    }
+
+    const auto targetFaces = static_cast<size_t>(
+        static_cast<double>(faces.size()) * glm::clamp(settings.targetRatio, 0.0f, 1.0f));
+
+    Simplifier simplifier{std::move(positions), std::move(faces)};
+    for (bool shifted : {false, true}) {
+        if (simplifier.aliveFaces() <= targetFaces) break;
+        simplifier.pass(settings, targetFaces, shifted);
+    }
+
+    auto result = simplifier.toBasicMesh(colors);
+    result->setModelMatrix(mesh.getModelMatrix());
+    result->setWorldMatrix(mesh.getWorldMatrix());
+    return result;
+}
+
+}  // namespace util
+
+}  // namespace inviwo
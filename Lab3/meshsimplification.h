@@ -0,0 +1,36 @@
+#pragma once
+
+#include <inviwo/tnm067lab3/tnm067lab3moduledefine.h>
+#include <inviwo/core/datastructures/geometry/basicmesh.h>
+
+#include <memory>
+
+namespace inviwo {
+
+namespace util {
+
+struct IVW_MODULE_TNM067LAB3_API MeshSimplificationSettings {
+    // Fraction of the input triangles to keep, simplification stops when it is reached
+    float targetRatio = 0.15f;
+    // Largest allowed quadric error of a collapse, given as a distance in data space
+    float maxError = 0.001f;
+    // The mesh is split into blocksPerAxis^3 spatial blocks that are simplified in parallel
+    size_t blocksPerAxis = 4;
+};
+
+/*
+ * Simplify a triangle mesh, such as the output of MarchingTetrahedra, using edge collapses
+ * ordered by quadric error metrics (Garland and Heckbert). The bounding box is divided into
+ * spatial blocks that are simplified concurrently, vertices connected to other blocks are kept
+ * fixed in a pass. A second pass with the block grid shifted by half a block lets those vertices
+ * be collapsed as well.
+ *
+ * Boundary vertices of open surfaces are never moved. Normals are recomputed for the simplified
+ * mesh, texture coordinates are set to the position and the color of the kept vertex is used.
+ */
+IVW_MODULE_TNM067LAB3_API std::shared_ptr<BasicMesh> simplifyMesh(
+    const BasicMesh& mesh, const MeshSimplificationSettings& settings);
+
+}  // namespace util
+
+}  // namespace inviwo
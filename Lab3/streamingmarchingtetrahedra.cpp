@@ -0,0 +1,284 @@
+#include <inviwo/tnm067lab3/util/streamingmarchingtetrahedra.h>
+#include <inviwo/tnm067lab3/util/tetrahedratables.h>
+#include <inviwo/core/util/exception.h>
+#include <inviwo/core/util/indexmapper.h>
+
+#include <fmt/format.h>
+
+#include <array>
+#include <bit>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+namespace inviwo {
+
+namespace {
+
+size_t voxelSize(DataFormatId format) {
+    switch (format) {
+        case DataFormatId::Int8:
+        case DataFormatId::UInt8:
+            return 1;
+        case DataFormatId::Int16:
+        case DataFormatId::UInt16:
+            return 2;
+        case DataFormatId::Int32:
+        case DataFormatId::UInt32:
+        case DataFormatId::Float32:
+            return 4;
+        case DataFormatId::Int64:
+        case DataFormatId::UInt64:
+        case DataFormatId::Float64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+template <typename T>
+void convert(const std::vector<char>& buffer, std::vector<double>& slice) {
+    const T* data = reinterpret_cast<const T*>(buffer.data());
+    for (size_t i = 0; i < slice.size(); ++i) {
+        slice[i] = static_cast<double>(data[i]);
+    }
+}
+
+struct EdgeHash {
+    size_t operator()(const std::pair<size_t, size_t>& edge) const {
+        return std::hash<size_t>{}(edge.first) ^ (std::hash<size_t>{}(edge.second) * 31);
+    }
+};
+
+/*
+ * Binary PLY writer for meshes of unknown size. The vertices are written directly after a header
+ * with fixed width placeholder counts and the faces are spooled to a temporary file, which is
+ * appended once all vertices are known. The counts are patched into the header at the end.
+ */
+class PlyWriter {
+public:
+    explicit PlyWriter(const std::filesystem::path& file)
+        : file_{file}
+        , facesFile_{std::filesystem::path{file}.concat(".faces.tmp")}
+        , out_{file_, std::ios::binary | std::ios::trunc}
+        , faces_{facesFile_, std::ios::binary | std::ios::trunc} {
+        if (!out_ || !faces_) {
+            throw Exception(fmt::format("Unable to open '{}' for writing", file_.string()),
+                            IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+        }
+        writeHeader();
+    }
+    PlyWriter(const PlyWriter&) = delete;
+    PlyWriter& operator=(const PlyWriter&) = delete;
+    ~PlyWriter() {
+        faces_.close();
+        std::error_code ec;
+        std::filesystem::remove(facesFile_, ec);
+    }
+
+    std::uint32_t addVertex(const vec3& pos) {
+        if (nVertices_ == std::numeric_limits<std::uint32_t>::max()) {
+            throw Exception("Too many vertices for 32 bit PLY face indices",
+                            IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+        }
+        out_.write(reinterpret_cast<const char*>(&pos), sizeof(vec3));
+        return static_cast<std::uint32_t>(nVertices_++);
+    }
+
+    void addTriangle(std::uint32_t i0, std::uint32_t i1, std::uint32_t i2) {
+        const std::uint8_t count = 3;
+        const std::array<std::uint32_t, 3> ids{i0, i1, i2};
+        faces_.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        faces_.write(reinterpret_cast<const char*>(ids.data()), sizeof(ids));
+        ++nTriangles_;
+    }
+
+    StreamingMarchingTetrahedra::Result finish() {
+        faces_.close();
+        if (nTriangles_ > 0) {
+            std::ifstream faces{facesFile_, std::ios::binary};
+            out_ << faces.rdbuf();
+        }
+        writeHeader();
+        out_.close();
+        if (!out_) {
+            throw Exception(fmt::format("Failed writing '{}'", file_.string()),
+                            IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+        }
+        return {nVertices_, nTriangles_};
+    }
+
+private:
+    void writeHeader() {
+        constexpr auto endian = std::endian::native == std::endian::little ? "binary_little_endian"
+                                                                           : "binary_big_endian";
+        out_.seekp(0);
+        out_ << "ply\n"
+             << "format " << endian << " 1.0\n"
+             << fmt::format("element vertex {:012}\n", nVertices_)
+             << "property float x\nproperty float y\nproperty float z\n"
+             << fmt::format("element face {:012}\n", nTriangles_)
+             << "property list uchar uint vertex_indices\n"
+             << "end_header\n";
+        out_.seekp(0, std::ios::end);
+    }
+
+    std::filesystem::path file_;
+    std::filesystem::path facesFile_;
+    std::ofstream out_;
+    std::ofstream faces_;
+    size_t nVertices_ = 0;
+    size_t nTriangles_ = 0;
+};
+
+}  // namespace
+
+StreamingMarchingTetrahedra::StreamingMarchingTetrahedra(std::filesystem::path rawFile,
+                                                         size3_t dims, DataFormatId format)
+    : rawFile_{std::move(rawFile)}, dims_{dims}, format_{format} {
+
+    const auto bytes = voxelSize(format_);
+    if (bytes == 0) {
+        throw Exception("Only scalar integer and float raw volumes are supported",
+                        IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+    }
+    if (glm::any(glm::lessThan(dims_, size3_t(2)))) {
+        throw Exception("The volume needs at least 2 voxels in each direction",
+                        IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+    }
+    const auto expected = dims_.x * dims_.y * dims_.z * bytes;
+    const auto actual = std::filesystem::file_size(rawFile_);
+    if (actual < expected) {
+        throw Exception(fmt::format("'{}' is {} bytes, expected at least {} bytes",
+                                    rawFile_.string(), actual, expected),
+                        IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+    }
+}
+
+void StreamingMarchingTetrahedra::readSlice(std::ifstream& in, size_t z, std::vector<char>& buffer,
+                                            std::vector<double>& slice) const {
+    const auto sliceBytes = static_cast<std::streamoff>(buffer.size());
+    in.seekg(static_cast<std::streamoff>(z) * sliceBytes);
+    in.read(buffer.data(), sliceBytes);
+    if (!in) {
+        throw Exception(fmt::format("Failed reading slice {} of '{}'", z, rawFile_.string()),
+                        IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+    }
+
+    switch (format_) {
+        case DataFormatId::Int8:
+            return convert<std::int8_t>(buffer, slice);
+        case DataFormatId::UInt8:
+            return convert<std::uint8_t>(buffer, slice);
+        case DataFormatId::Int16:
+            return convert<std::int16_t>(buffer, slice);
+        case DataFormatId::UInt16:
+            return convert<std::uint16_t>(buffer, slice);
+        case DataFormatId::Int32:
+            return convert<std::int32_t>(buffer, slice);
+        case DataFormatId::UInt32:
+            return convert<std::uint32_t>(buffer, slice);
+        case DataFormatId::Float32:
+            return convert<float>(buffer, slice);
+        case DataFormatId::Int64:
+            return convert<std::int64_t>(buffer, slice);
+        case DataFormatId::UInt64:
+            return convert<std::uint64_t>(buffer, slice);
+        case DataFormatId::Float64:
+            return convert<double>(buffer, slice);
+        default:
+            break;
+    }
+}
+
+StreamingMarchingTetrahedra::Result StreamingMarchingTetrahedra::extract(
+    float iso, const std::filesystem::path& plyFile) const {
+
+    std::ifstream in{rawFile_, std::ios::binary};
+    if (!in) {
+        throw Exception(fmt::format("Unable to open '{}'", rawFile_.string()),
+                        IVW_CONTEXT_CUSTOM("StreamingMarchingTetrahedra"));
+    }
+
+    PlyWriter ply{plyFile};
+
+    const size_t sliceSize = dims_.x * dims_.y;
+    std::vector<char> buffer(sliceSize * voxelSize(format_));
+    std::array<std::vector<double>, 2> slices{std::vector<double>(sliceSize),
+                                              std::vector<double>(sliceSize)};
+
+    util::IndexMapper3D mapVolPosToIndex(dims_);
+    const dvec3 spacing = 1.0 / (dvec3(dims_) - 1.0);
+
+    // Vertex ids of the edges touching the active slab, keyed on the volume index of the end
+    // points just like MeshHelper::addVertex
+    std::unordered_map<std::pair<size_t, size_t>, std::uint32_t, EdgeHash> edgeToVertex;
+
+    namespace tables = TNM067::TetrahedraTables;
+    std::array<double, 8> values{};
+    std::array<size_t, 8> indices{};
+    std::array<vec3, 8> positions{};
+    std::array<std::uint32_t, 64> cellVertices{};
+
+    readSlice(in, 0, buffer, slices[0]);
+    for (size_t z = 0; z < dims_.z - 1; ++z) {
+        readSlice(in, z + 1, buffer, slices[1]);
+
+        for (size_t y = 0; y < dims_.y - 1; ++y) {
+            for (size_t x = 0; x < dims_.x - 1; ++x) {
+                for (size_t corner = 0; corner < 8; ++corner) {
+                    const size3_t offset{corner & 1, (corner >> 1) & 1, (corner >> 2) & 1};
+                    const size3_t pos = size3_t(x, y, z) + offset;
+                    values[corner] = slices[offset.z][pos.x + pos.y * dims_.x];
+                    indices[corner] = mapVolPosToIndex(pos);
+                    positions[corner] = vec3(dvec3(pos) * spacing);
+                }
+
+                std::uint8_t above = 0;
+                for (size_t corner = 0; corner < 8; ++corner) {
+                    if (values[corner] >= iso) above |= static_cast<std::uint8_t>(1 << corner);
+                }
+                if (above == 0 || above == 0xff) continue;
+
+                cellVertices.fill(std::numeric_limits<std::uint32_t>::max());
+                for (size_t tet = 0; tet < tables::tetrahedraIds.size(); ++tet) {
+                    const auto& tetCase = tables::cellCases[tet][tables::caseId(above, tet)];
+
+                    std::array<std::uint32_t, 4> edgeVertices{};
+                    for (size_t e = 0; e < tetCase.nEdges; ++e) {
+                        const auto [a, b] = tetCase.edges[e];
+                        auto& vertex = cellVertices[std::min(a, b) * 8 + std::max(a, b)];
+                        if (vertex == std::numeric_limits<std::uint32_t>::max()) {
+                            auto key = std::make_pair(indices[a], indices[b]);
+                            if (key.second < key.first) std::swap(key.first, key.second);
+
+                            auto [it, inserted] = edgeToVertex.try_emplace(key, 0);
+                            if (inserted) {
+                                const auto t = static_cast<float>(
+                                    std::abs((iso - values[a]) / (values[b] - values[a])));
+                                it->second =
+                                    ply.addVertex(positions[a] * (1.0f - t) + positions[b] * t);
+                            }
+                            vertex = it->second;
+                        }
+                        edgeVertices[e] = vertex;
+                    }
+                    for (size_t i = 0; i < tetCase.nTriangles; ++i) {
+                        const auto& tri = tetCase.triangles[i];
+                        ply.addTriangle(edgeVertices[tri[0]], edgeVertices[tri[1]],
+                                        edgeVertices[tri[2]]);
+                    }
+                }
+            }
+        }
+
+        // Only edges within slice z + 1 are shared with the next slab
+        const size_t firstKept = (z + 1) * sliceSize;
+        std::erase_if(edgeToVertex, [&](const auto& item) { return item.first.first < firstKept; });
+        std::swap(slices[0], slices[1]);
+    }
+
+    return ply.finish();
+}
+
+}  // namespace inviwo
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <inviwo/tnm067lab3/tnm067lab3moduledefine.h>
+#include <inviwo/core/util/glm.h>
+#include <inviwo/core/util/formats.h>
+
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+namespace inviwo {
+
+/*
+ * Out-of-core version of the MarchingTetrahedra extraction for raw volumes that are too large to
+ * be loaded as a VolumeRAM. The raw file is read two z-slices at a time and the resulting
+ * triangles are appended to a binary PLY file while extracting. Only the two active slices and
+ * the vertex ids of the edges in the active slab are kept in memory.
+ *
+ * The cells are split into the same 6 tetrahedra as MarchingTetrahedra and vertices are shared
+ * along the same volume edges, so the PLY has the same number of vertices and triangles as the
+ * mesh of the processor. Vertex positions are in the same [0,1] data space but are interpolated in
+ * double precision, and the vertex order may differ. Normals are not written and the model and
+ * world matrices are left to the reader.
+ */
+class IVW_MODULE_TNM067LAB3_API StreamingMarchingTetrahedra {
+public:
+    struct Result {
+        size_t vertices = 0;
+        size_t triangles = 0;
+    };
+
+    /*
+     * @param rawFile headerless, native byte order volume file, x fastest then y then z
+     * @param dims the number of voxels in each direction
+     * @param format scalar format of the voxels
+     */
+    StreamingMarchingTetrahedra(std::filesystem::path rawFile, size3_t dims, DataFormatId format);
+
+    /*
+     * Extract the iso surface at `iso` and write it to `plyFile`. A temporary file next to
+     * `plyFile` is used to spool the faces until all vertices are written.
+     */
+    Result extract(float iso, const std::filesystem::path& plyFile) const;
+
+private:
+    void readSlice(std::ifstream& in, size_t z, std::vector<char>& buffer,
+                   std::vector<double>& slice) const;
+
+    std::filesystem::path rawFile_;
+    size3_t dims_;
+    DataFormatId format_;
+};
+
+}  // namespace inviwo
@@ -0,0 +1,124 @@
+#include <inviwo/tnm067lab3/util/adaptivetetrahedra.h>
+#include <inviwo/tnm067lab3/util/tetrahedratables.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace inviwo {
+
+namespace {
+
+const size3_t dims{40, 42, 38};
+constexpr double iso = 12.0;
+
+/*
+ * Distance to the center with a ripple, the iso surface is a closed bumpy sphere well inside the
+ * volume.
+ */
+std::shared_ptr<VolumeRAMPrecision<float>> bumpySphere() {
+    auto volume = std::make_shared<VolumeRAMPrecision<float>>(dims);
+    auto data = volume->getDataTyped();
+    size3_t pos{};
+    for (pos.z = 0; pos.z < dims.z; ++pos.z) {
+        for (pos.y = 0; pos.y < dims.y; ++pos.y) {
+            for (pos.x = 0; pos.x < dims.x; ++pos.x) {
+                const vec3 p{pos};
+                const float ripple = 1.5f * std::sin(0.3f * p.x) * std::cos(0.25f * p.y);
+                data[pos.x + dims.x * (pos.y + dims.y * pos.z)] =
+                    glm::distance(p, vec3{19.3f, 20.1f, 18.7f}) + ripple;
+            }
+        }
+    }
+    return volume;
+}
+
+size_t voxelIndex(const size3_t& pos) { return pos.x + dims.x * (pos.y + dims.y * pos.z); }
+
+std::pair<size_t, size_t> sorted(size_t a, size_t b) {
+    return a < b ? std::pair{a, b} : std::pair{b, a};
+}
+
+/*
+ * Extract the iso surface of the tetrahedra with one vertex per crossed volume edge, and count
+ * how many triangles use each edge of the resulting mesh.
+ */
+std::map<std::pair<size_t, size_t>, size_t> meshEdgeUses(
+    const VolumeRAM& volume, const std::vector<std::array<size3_t, 4>>& tetrahedra) {
+    using namespace TNM067::TetrahedraTables;
+
+    std::map<std::pair<size_t, size_t>, size_t> vertexIds;
+    auto vertex = [&](const size3_t& a, const size3_t& b) {
+        const auto key = sorted(voxelIndex(a), voxelIndex(b));
+        return vertexIds.try_emplace(key, vertexIds.size()).first->second;
+    };
+
+    std::map<std::pair<size_t, size_t>, size_t> uses;
+    for (const auto& tet : tetrahedra) {
+        size_t id = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            id |= static_cast<size_t>(volume.getAsDouble(tet[i]) >= iso ? 1 : 0) << i;
+        }
+        const auto& tetCase = tetrahedronCases[id];
+        for (size_t t = 0; t < tetCase.nTriangles; ++t) {
+            std::array<size_t, 3> ids;
+            for (size_t i = 0; i < 3; ++i) {
+                const auto& edge = tetCase.edges[tetCase.triangles[t][i]];
+                ids[i] = vertex(tet[edge[0]], tet[edge[1]]);
+            }
+            for (size_t i = 0; i < 3; ++i) ++uses[sorted(ids[i], ids[(i + 1) % 3])];
+        }
+    }
+    return uses;
+}
+
+// Number of tetrahedra crossed by the iso surface in the uniform split of every cell
+size_t uniformCount(const VolumeRAM& volume) {
+    using namespace TNM067::TetrahedraTables;
+
+    size_t count = 0;
+    size3_t pos{};
+    for (pos.z = 0; pos.z + 1 < dims.z; ++pos.z) {
+        for (pos.y = 0; pos.y + 1 < dims.y; ++pos.y) {
+            for (pos.x = 0; pos.x + 1 < dims.x; ++pos.x) {
+                std::uint8_t cornerMask = 0;
+                for (std::uint8_t corner = 0; corner < 8; ++corner) {
+                    const size3_t cornerPos =
+                        pos + size3_t{corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u};
+                    if (volume.getAsDouble(cornerPos) >= iso) cornerMask |= 1 << corner;
+                }
+                for (size_t t = 0; t < tetrahedraIds.size(); ++t) {
+                    const auto id = caseId(cornerMask, t);
+                    if (id != 0 && id != 15) ++count;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+TEST(AdaptiveTetrahedra, ClosedSurfaceWithFewerTetrahedra) {
+    const auto volume = bumpySphere();
+    const auto tetrahedra = util::adaptiveTetrahedra(*volume, iso, 0.01, 16);
+    ASSERT_FALSE(tetrahedra.empty());
+
+    // The surface is closed, a crack between resolutions leaves edges with a single triangle
+    const auto uses = meshEdgeUses(*volume, tetrahedra);
+    ASSERT_FALSE(uses.empty());
+    for (const auto& [edge, count] : uses) {
+        EXPECT_EQ(count, 2u) << "Mesh edge (" << edge.first << ", " << edge.second
+                             << ") is used by " << count << " triangles";
+    }
+
+    EXPECT_LT(tetrahedra.size(), uniformCount(*volume));
+}
+
+}  // namespace inviwo
@@ -0,0 +1,145 @@
+#include <inviwo/tnm067lab3/util/meshsimplification.h>
+#include <inviwo/core/datastructures/buffer/bufferram.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <array>
+#include <cmath>
+#include <set>
+#include <vector>
+
+namespace inviwo {
+
+namespace {
+
+// Vertices along each side of the grid
+constexpr size_t gridSize = 41;
+
+float height(float u, float v) { return 0.1f * std::sin(4.0f * u) * std::cos(3.0f * v); }
+
+dvec3 surfaceNormal(double u, double v) {
+    return {-0.4 * std::cos(4.0 * u) * std::cos(3.0 * v),
+            0.3 * std::sin(4.0 * u) * std::sin(3.0 * v), 1.0};
+}
+
+/*
+ * Open height field over [0, 1]^2 with all triangles facing +z, so every vertex on the border of
+ * the grid is an open boundary vertex.
+ */
+std::shared_ptr<BasicMesh> heightField() {
+    std::vector<BasicMesh::Vertex> vertices;
+    for (size_t y = 0; y < gridSize; ++y) {
+        for (size_t x = 0; x < gridSize; ++x) {
+            const float u = static_cast<float>(x) / static_cast<float>(gridSize - 1);
+            const float v = static_cast<float>(y) / static_cast<float>(gridSize - 1);
+            const vec3 pos{u, v, height(u, v)};
+            vertices.push_back({pos, vec3(0.0f, 0.0f, 1.0f), pos, vec4(1.0f)});
+        }
+    }
+
+    auto mesh = std::make_shared<BasicMesh>();
+    auto& indices =
+        mesh->addIndexBuffer(DrawType::Triangles, ConnectivityType::None)->getDataContainer();
+    for (std::uint32_t y = 0; y + 1 < gridSize; ++y) {
+        for (std::uint32_t x = 0; x + 1 < gridSize; ++x) {
+            const std::uint32_t i = x + y * static_cast<std::uint32_t>(gridSize);
+            const std::uint32_t up = i + static_cast<std::uint32_t>(gridSize);
+            for (auto id : {i, i + 1, up + 1, i, up + 1, up}) {
+                indices.push_back(id);
+            }
+        }
+    }
+    mesh->addVertices(vertices);
+    return mesh;
+}
+
+struct Triangles {
+    std::vector<dvec3> positions;
+    std::vector<std::array<std::uint32_t, 3>> faces;
+};
+
+Triangles triangles(const BasicMesh& mesh) {
+    Triangles result;
+    const auto positions =
+        mesh.findBuffer(BufferType::PositionAttrib).first->getRepresentation<BufferRAM>();
+    for (size_t i = 0; i < positions->getSize(); ++i) {
+        result.positions.push_back(positions->getAsDVec3(i));
+    }
+    for (const auto& [info, indexBuffer] : mesh.getIndexBuffers()) {
+        const auto& indices = indexBuffer->getRAMRepresentation()->getDataContainer();
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            result.faces.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        }
+    }
+    return result;
+}
+
+util::MeshSimplificationSettings settings() {
+    util::MeshSimplificationSettings settings;
+    settings.targetRatio = 0.25f;
+    // Large enough to not stop the simplification before the target is reached
+    settings.maxError = 1.0f;
+    settings.blocksPerAxis = 4;
+    return settings;
+}
+
+}  // namespace
+
+TEST(MeshSimplification, ReachesTargetRatio) {
+    const auto input = triangles(*heightField());
+    const auto output = triangles(*util::simplifyMesh(*heightField(), settings()));
+
+    const double target = settings().targetRatio * static_cast<double>(input.faces.size());
+    EXPECT_LE(static_cast<double>(output.faces.size()), 1.1 * target);
+    EXPECT_GE(static_cast<double>(output.faces.size()), 0.9 * target);
+}
+
+TEST(MeshSimplification, KeepsBoundaryVertices) {
+    const auto input = triangles(*heightField());
+    const auto output = triangles(*util::simplifyMesh(*heightField(), settings()));
+
+    const std::set<std::array<double, 3>> kept = [&]() {
+        std::set<std::array<double, 3>> result;
+        for (const auto& p : output.positions) result.insert({p.x, p.y, p.z});
+        return result;
+    }();
+    for (const auto& p : input.positions) {
+        if (p.x == 0.0 || p.x == 1.0 || p.y == 0.0 || p.y == 1.0) {
+            EXPECT_TRUE(kept.count({p.x, p.y, p.z}))
+                << "Boundary vertex (" << p.x << ", " << p.y << ", " << p.z << ") moved";
+        }
+    }
+}
+
+TEST(MeshSimplification, NoFlippedTriangles) {
+    const auto output = triangles(*util::simplifyMesh(*heightField(), settings()));
+
+    for (const auto& face : output.faces) {
+        const auto& a = output.positions[face[0]];
+        const auto& b = output.positions[face[1]];
+        const auto& c = output.positions[face[2]];
+        const auto normal = glm::cross(b - a, c - a);
+        const auto center = (a + b + c) / 3.0;
+        EXPECT_GT(glm::dot(normal, surfaceNormal(center.x, center.y)), 0.0)
+            << "Triangle (" << face[0] << ", " << face[1] << ", " << face[2] << ") is flipped";
+    }
+}
+
+TEST(MeshSimplification, IndependentOfThreadCount) {
+    const auto threads = util::threadCount();
+
+    util::setThreadCount(1);
+    const auto serial = triangles(*util::simplifyMesh(*heightField(), settings()));
+    util::setThreadCount(4);
+    const auto parallel = triangles(*util::simplifyMesh(*heightField(), settings()));
+    util::setThreadCount(threads);
+
+    EXPECT_EQ(serial.positions, parallel.positions);
+    EXPECT_EQ(serial.faces, parallel.faces);
+}
+
+}  // namespace inviwo
@@ -0,0 +1,146 @@
+#include <inviwo/tnm067lab3/util/streamingmarchingtetrahedra.h>
+#include <inviwo/tnm067lab3/processors/marchingtetrahedra.h>
+#include <inviwo/core/common/inviwoapplication.h>
+#include <inviwo/core/datastructures/geometry/mesh.h>
+#include <inviwo/core/datastructures/volume/volume.h>
+#include <inviwo/core/datastructures/volume/volumeramprecision.h>
+#include <inviwo/core/network/networklock.h>
+#include <inviwo/core/network/processornetwork.h>
+#include <inviwo/core/ports/meshport.h>
+#include <inviwo/core/ports/volumeport.h>
+#include <inviwo/core/processors/processor.h>
+#include <inviwo/core/properties/ordinalproperty.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace inviwo {
+
+namespace {
+
+const size3_t dims{24, 20, 17};
+constexpr float iso = 0.5f;
+
+// Two overlapping balls in [0, 1], above the iso value inside
+float value(const size3_t& pos) {
+    const auto ball = [&](const vec3& center, float radius) {
+        return 0.5f + (radius - glm::distance(vec3(pos), center)) / (4.0f * radius);
+    };
+    return std::clamp(std::max(ball({9.0f, 9.5f, 8.0f}, 5.5f), ball({15.2f, 10.0f, 8.6f}, 4.3f)),
+                      0.0f, 1.0f);
+}
+
+struct PlyCounts {
+    size_t vertices = 0;
+    size_t faces = 0;
+};
+
+PlyCounts readPlyHeader(const std::filesystem::path& file) {
+    std::ifstream in{file, std::ios::binary};
+    PlyCounts counts;
+    std::string line;
+    while (std::getline(in, line) && line != "end_header") {
+        std::istringstream words{line};
+        std::string keyword, element;
+        size_t count = 0;
+        if (words >> keyword >> element >> count && keyword == "element") {
+            if (element == "vertex") counts.vertices = count;
+            if (element == "face") counts.faces = count;
+        }
+    }
+    EXPECT_EQ(line, "end_header") << "Incomplete PLY header in " << file;
+    return counts;
+}
+
+// Provides the volume to the MarchingTetrahedra processor
+class VolumeSource : public Processor {
+public:
+    VolumeSource() : Processor("volumeSource", "Volume Source"), outport_("outport") {
+        addPort(outport_);
+    }
+
+    virtual const ProcessorInfo& getProcessorInfo() const override {
+        static const ProcessorInfo info{"org.inviwo.TNM067TestVolumeSource", "Test Volume Source",
+                                        "TNM067", CodeState::Experimental, Tags::CPU};
+        return info;
+    }
+    virtual void process() override {}
+
+    VolumeOutport outport_;
+};
+
+}  // namespace
+
+TEST(StreamingMarchingTetrahedra, MatchesInCoreCounts) {
+    auto ram = std::make_shared<VolumeRAMPrecision<float>>(dims);
+    auto data = ram->getDataTyped();
+    size3_t pos{};
+    for (pos.z = 0; pos.z < dims.z; ++pos.z) {
+        for (pos.y = 0; pos.y < dims.y; ++pos.y) {
+            for (pos.x = 0; pos.x < dims.x; ++pos.x) {
+                data[pos.x + dims.x * (pos.y + dims.y * pos.z)] = value(pos);
+            }
+        }
+    }
+
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto rawFile = dir / "tnm067lab3-streaming-test.raw";
+    const auto plyFile = dir / "tnm067lab3-streaming-test.ply";
+    {
+        std::ofstream out{rawFile, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(data),
+                  static_cast<std::streamsize>(dims.x * dims.y * dims.z * sizeof(float)));
+        ASSERT_TRUE(out) << "Unable to write " << rawFile;
+    }
+
+    const auto result = StreamingMarchingTetrahedra{rawFile, dims, DataFormatId::Float32}.extract(
+        iso, plyFile);
+    const auto ply = readPlyHeader(plyFile);
+    EXPECT_EQ(ply.vertices, result.vertices);
+    EXPECT_EQ(ply.faces, result.triangles);
+    EXPECT_GT(ply.faces, 0u);
+
+    auto volume = std::make_shared<Volume>(ram);
+    volume->dataMap.dataRange = dvec2(0.0, 1.0);
+    volume->dataMap.valueRange = dvec2(0.0, 1.0);
+
+    auto& network = *InviwoApplication::getPtr()->getProcessorNetwork();
+    NetworkLock lock(&network);
+    auto* source = static_cast<VolumeSource*>(
+        network.addProcessor(std::make_unique<VolumeSource>()));
+    auto* marching = static_cast<MarchingTetrahedra*>(
+        network.addProcessor(std::make_unique<MarchingTetrahedra>()));
+    network.addConnection(&source->outport_, marching->getInport("volume"));
+    source->outport_.setData(volume);
+
+    auto* isoValue = dynamic_cast<FloatProperty*>(marching->getPropertyByIdentifier("isoValue"));
+    ASSERT_NE(isoValue, nullptr);
+    isoValue->set(iso);
+    marching->process();
+
+    auto* outport = dynamic_cast<MeshOutport*>(marching->getOutport("mesh"));
+    ASSERT_NE(outport, nullptr);
+    const auto mesh = outport->getData();
+    ASSERT_NE(mesh, nullptr);
+    size_t triangles = 0;
+    for (const auto& [meshInfo, indices] : mesh->getIndexBuffers()) {
+        triangles += indices->getSize() / 3;
+    }
+    EXPECT_EQ(ply.vertices, mesh->getBuffer(0)->getSize());
+    EXPECT_EQ(ply.faces, triangles);
+
+    network.removeProcessor(marching);
+    network.removeProcessor(source);
+    std::filesystem::remove(rawFile);
+    std::filesystem::remove(plyFile);
+}
+
+}  // namespace inviwo
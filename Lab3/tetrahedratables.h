@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace inviwo {
+
+namespace TNM067 {
+namespace TetrahedraTables {
+
+// clang-format off
+    /*
+    Cell corners, index = x + 2 * y + 4 * z
+
+          6-------7
+         /|      /|
+        4-------5 |
+        | 2-----|-3
+        |/      |/
+        0-------1
+
+    The cell is split into 6 tetrahedra sharing the diagonal 2-5
+    */
+// clang-format on
+constexpr std::array<std::array<std::uint8_t, 4>, 6> tetrahedraIds = {
+    {{0, 1, 2, 5}, {1, 3, 2, 5}, {3, 2, 5, 7}, {0, 2, 4, 5}, {6, 4, 2, 5}, {6, 7, 5, 2}}};
+
+/*
+ * The edges crossed by the iso surface for one case, each listed once in the order they are
+ * first used, and the triangles as indices into `edges`. Case id bit i is set when vertex i is
+ * at or above the iso value.
+ */
+struct TetrahedronCase {
+    std::uint8_t nEdges;
+    std::array<std::array<std::uint8_t, 2>, 4> edges;
+    std::uint8_t nTriangles;
+    std::array<std::array<std::uint8_t, 3>, 2> triangles;
+};
+
+// clang-format off
+constexpr std::array<TetrahedronCase, 16> tetrahedronCases = {{
+    {0, {}, 0, {}},
+    {3, {{{0, 1}, {0, 2}, {0, 3}}}, 1, {{{1, 0, 2}}}},
+    {3, {{{1, 3}, {1, 2}, {1, 0}}}, 1, {{{1, 0, 2}}}},
+    {4, {{{1, 3}, {1, 2}, {0, 3}, {0, 2}}}, 2, {{{0, 2, 1}, {1, 2, 3}}}},
+    {3, {{{2, 3}, {2, 0}, {2, 1}}}, 1, {{{2, 1, 0}}}},
+    {4, {{{0, 1}, {2, 1}, {0, 3}, {2, 3}}}, 2, {{{0, 2, 1}, {2, 3, 1}}}},
+    {4, {{{1, 0}, {1, 3}, {2, 0}, {2, 3}}}, 2, {{{2, 1, 0}, {2, 3, 1}}}},
+    {3, {{{3, 2}, {3, 1}, {3, 0}}}, 1, {{{2, 0, 1}}}},
+    {3, {{{3, 2}, {3, 1}, {3, 0}}}, 1, {{{1, 0, 2}}}},
+    {4, {{{1, 0}, {1, 3}, {2, 0}, {2, 3}}}, 2, {{{0, 1, 2}, {1, 3, 2}}}},
+    {4, {{{0, 1}, {2, 1}, {0, 3}, {2, 3}}}, 2, {{{1, 2, 0}, {1, 3, 2}}}},
+    {3, {{{2, 3}, {2, 0}, {2, 1}}}, 1, {{{0, 1, 2}}}},
+    {4, {{{1, 3}, {1, 2}, {0, 3}, {0, 2}}}, 2, {{{1, 2, 0}, {3, 2, 1}}}},
+    {3, {{{1, 3}, {1, 2}, {1, 0}}}, 1, {{{2, 0, 1}}}},
+    {3, {{{0, 1}, {0, 2}, {0, 3}}}, 1, {{{2, 0, 1}}}},
+    {0, {}, 0, {}},
+}};
+// clang-format on
+
+/*
+ * tetrahedronCases for each of the 6 tetrahedra with the edges given as cell corners,
+ * cellCases[tetrahedron][caseId]
+ */
+constexpr std::array<std::array<TetrahedronCase, 16>, 6> cellCases = [] {
+    std::array<std::array<TetrahedronCase, 16>, 6> result{};
+    for (size_t t = 0; t < 6; ++t) {
+        for (size_t c = 0; c < 16; ++c) {
+            auto tetCase = tetrahedronCases[c];
+            for (auto& edge : tetCase.edges) {
+                edge = {tetrahedraIds[t][edge[0]], tetrahedraIds[t][edge[1]]};
+            }
+            result[t][c] = tetCase;
+        }
+    }
+    return result;
+}();
+
+// Case id of tetrahedron t given a mask with bit i set for cell corners at or above the iso value
+constexpr size_t caseId(std::uint8_t cornerMask, size_t t) {
+    size_t id = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        id |= static_cast<size_t>((cornerMask >> tetrahedraIds[t][i]) & 1) << i;
+    }
+    return id;
+}
+
+namespace detail {
+
+// Every edge has to go from a vertex above to one below the iso value, and the complement case
+// has to use the same edges with reversed triangles
+constexpr bool isConsistent() {
+    for (size_t c = 0; c < 16; ++c) {
+        const auto& tetCase = tetrahedronCases[c];
+        const auto& complement = tetrahedronCases[15 - c];
+        if (tetCase.nEdges != complement.nEdges || tetCase.nTriangles != complement.nTriangles) {
+            return false;
+        }
+        for (size_t e = 0; e < tetCase.nEdges; ++e) {
+            const auto [a, b] = tetCase.edges[e];
+            if (((c >> a) & 1) == ((c >> b) & 1) || tetCase.edges[e] != complement.edges[e]) {
+                return false;
+            }
+        }
+        for (size_t t = 0; t < tetCase.nTriangles; ++t) {
+            const auto& tri = tetCase.triangles[t];
+            const auto& rev = complement.triangles[t];
+            if (tri[0] != rev[2] || tri[1] != rev[1] || tri[2] != rev[0]) return false;
+        }
+    }
+    return true;
+}
+static_assert(isConsistent(), "Inconsistent marching tetrahedra case table");
+
+}  // namespace detail
+
+}  // namespace TetrahedraTables
+}  // namespace TNM067
+}  // namespace inviwo
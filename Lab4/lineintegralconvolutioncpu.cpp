@@ -0,0 +1,323 @@
+#include <inviwo/tnm067lab4/util/lineintegralconvolutioncpu.h>
+#include <inviwo/tnm067lab1/util/interpolationmethods.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+#include <inviwo/core/datastructures/image/image.h>
+#include <inviwo/core/datastructures/image/layerram.h>
+#include <inviwo/core/datastructures/image/layerramprecision.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace inviwo {
+
+namespace {
+
+// Number of pixels integrated together
+constexpr size_t lanes = 8;
+using Lane = std::array<float, lanes>;
+
+// Rows per FastLIC band, fixed so the result does not depend on the number of threads
+constexpr size_t bandHeight = 64;
+
+// LineIntegralConvolutionCPU::sampleLinear for the n positions (x[i], y[i])
+void sampleLanes(const std::vector<float>& plane, size2_t dims, const float* x, const float* y,
+                 size_t n, float* result) {
+    const float width = static_cast<float>(dims.x);
+    const float height = static_cast<float>(dims.y);
+    const int maxX = static_cast<int>(dims.x) - 1;
+    const int maxY = static_cast<int>(dims.y) - 1;
+
+    Lane fx, fy;
+    std::array<int, lanes> x0, x1, y0, y1;
+    for (size_t i = 0; i < n; ++i) {
+        const float px = x[i] * width - 0.5f;
+        const float py = y[i] * height - 0.5f;
+        const float baseX = std::floor(px);
+        const float baseY = std::floor(py);
+        fx[i] = px - baseX;
+        fy[i] = py - baseY;
+        x0[i] = std::clamp(static_cast<int>(baseX), 0, maxX);
+        x1[i] = std::clamp(static_cast<int>(baseX) + 1, 0, maxX);
+        y0[i] = std::clamp(static_cast<int>(baseY), 0, maxY) * static_cast<int>(dims.x);
+        y1[i] = std::clamp(static_cast<int>(baseY) + 1, 0, maxY) * static_cast<int>(dims.x);
+    }
+
+    Lane v00, v10, v01, v11;
+    for (size_t i = 0; i < n; ++i) {
+        v00[i] = plane[x0[i] + y0[i]];
+        v10[i] = plane[x1[i] + y0[i]];
+        v01[i] = plane[x0[i] + y1[i]];
+        v11[i] = plane[x1[i] + y1[i]];
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        const std::array<float, 4> v = {v00[i], v10[i], v01[i], v11[i]};
+        result[i] = TNM067::Interpolation::bilinear(v, fx[i], fy[i]);
+    }
+}
+
+}  // namespace
+
+LineIntegralConvolutionCPU::LineIntegralConvolutionCPU(const LayerRAM& vectorField,
+                                                       const LayerRAM& noise)
+    : fieldDims_{vectorField.getDimensions()}
+    , fieldX_(fieldDims_.x * fieldDims_.y)
+    , fieldY_(fieldDims_.x * fieldDims_.y)
+    , noiseDims_{noise.getDimensions()}
+    , noise_(noiseDims_.x * noiseDims_.y) {
+
+    for (size_t y = 0; y < fieldDims_.y; ++y) {
+        for (size_t x = 0; x < fieldDims_.x; ++x) {
+            const auto v = vectorField.getAsDVec2(size2_t(x, y));
+            fieldX_[x + y * fieldDims_.x] = static_cast<float>(v.x);
+            fieldY_[x + y * fieldDims_.x] = static_cast<float>(v.y);
+        }
+    }
+    for (size_t y = 0; y < noiseDims_.y; ++y) {
+        for (size_t x = 0; x < noiseDims_.x; ++x) {
+            noise_[x + y * noiseDims_.x] = static_cast<float>(noise.getAsDouble(size2_t(x, y)));
+        }
+    }
+}
+
+LineIntegralConvolutionCPU::LineIntegralConvolutionCPU(size2_t fieldDims,
+                                                       std::vector<float> fieldX,
+                                                       std::vector<float> fieldY,
+                                                       size2_t noiseDims, std::vector<float> noise)
+    : fieldDims_{fieldDims}
+    , fieldX_{std::move(fieldX)}
+    , fieldY_{std::move(fieldY)}
+    , noiseDims_{noiseDims}
+    , noise_{std::move(noise)} {}
+
+float LineIntegralConvolutionCPU::sampleLinear(const std::vector<float>& plane, size2_t dims,
+                                               vec2 texCoord) {
+    const vec2 p = texCoord * vec2(dims) - 0.5f;
+    const vec2 base = glm::floor(p);
+    const vec2 f = p - base;
+
+    const ivec2 maxPos = ivec2(dims) - 1;
+    const ivec2 p0 = glm::clamp(ivec2(base), ivec2(0), maxPos);
+    const ivec2 p1 = glm::clamp(ivec2(base) + 1, ivec2(0), maxPos);
+
+    const std::array<float, 4> v = {plane[p0.x + p0.y * dims.x], plane[p1.x + p0.y * dims.x],
+                                    plane[p0.x + p1.y * dims.x], plane[p1.x + p1.y * dims.x]};
+    return TNM067::Interpolation::bilinear(v, f.x, f.y);
+}
+
+vec2 LineIntegralConvolutionCPU::sampleField(vec2 texCoord) const {
+    return {sampleLinear(fieldX_, fieldDims_, texCoord),
+            sampleLinear(fieldY_, fieldDims_, texCoord)};
+}
+
+float LineIntegralConvolutionCPU::sampleNoise(vec2 texCoord) const {
+    return sampleLinear(noise_, noiseDims_, texCoord);
+}
+
+vec2 LineIntegralConvolutionCPU::direction(vec2 texCoord) const {
+    const vec2 v = sampleField(texCoord);
+    const float length = glm::length(v);
+    return length > 0.0f ? v / length : vec2(0.0f);
+}
+
+vec2 LineIntegralConvolutionCPU::step(vec2 pos, float stepSize, Integration integration) const {
+    const vec2 k1 = direction(pos);
+    if (integration == Integration::Euler) {
+        return pos + stepSize * k1;
+    }
+    const vec2 k2 = direction(pos + k1 * stepSize / 2.0f);
+    const vec2 k3 = direction(pos + k2 * stepSize / 2.0f);
+    const vec2 k4 = direction(pos + k3 * stepSize);
+    return pos + (stepSize / 6.0f) * (k1 + 2.0f * k2 + 2.0f * k3 + k4);
+}
+
+void LineIntegralConvolutionCPU::direction(const float* x, const float* y, size_t n, float* dirX,
+                                           float* dirY) const {
+    sampleLanes(fieldX_, fieldDims_, x, y, n, dirX);
+    sampleLanes(fieldY_, fieldDims_, x, y, n, dirY);
+    for (size_t i = 0; i < n; ++i) {
+        const float length = std::sqrt(dirX[i] * dirX[i] + dirY[i] * dirY[i]);
+        dirX[i] = length > 0.0f ? dirX[i] / length : 0.0f;
+        dirY[i] = length > 0.0f ? dirY[i] / length : 0.0f;
+    }
+}
+
+void LineIntegralConvolutionCPU::step(float* x, float* y, size_t n, float stepSize,
+                                      Integration integration) const {
+    Lane k1x, k1y;
+    direction(x, y, n, k1x.data(), k1y.data());
+    if (integration == Integration::Euler) {
+        for (size_t i = 0; i < n; ++i) {
+            x[i] += stepSize * k1x[i];
+            y[i] += stepSize * k1y[i];
+        }
+        return;
+    }
+
+    Lane px{}, py{}, k2x, k2y, k3x, k3y, k4x, k4y;
+    for (size_t i = 0; i < n; ++i) {
+        px[i] = x[i] + k1x[i] * stepSize / 2.0f;
+        py[i] = y[i] + k1y[i] * stepSize / 2.0f;
+    }
+    direction(px.data(), py.data(), n, k2x.data(), k2y.data());
+    for (size_t i = 0; i < n; ++i) {
+        px[i] = x[i] + k2x[i] * stepSize / 2.0f;
+        py[i] = y[i] + k2y[i] * stepSize / 2.0f;
+    }
+    direction(px.data(), py.data(), n, k3x.data(), k3y.data());
+    for (size_t i = 0; i < n; ++i) {
+        px[i] = x[i] + k3x[i] * stepSize;
+        py[i] = y[i] + k3y[i] * stepSize;
+    }
+    direction(px.data(), py.data(), n, k4x.data(), k4y.data());
+    for (size_t i = 0; i < n; ++i) {
+        x[i] += (stepSize / 6.0f) * (k1x[i] + 2.0f * k2x[i] + 2.0f * k3x[i] + k4x[i]);
+        y[i] += (stepSize / 6.0f) * (k1y[i] + 2.0f * k2y[i] + 2.0f * k3y[i] + k4y[i]);
+    }
+}
+
+void LineIntegralConvolutionCPU::renderRow(size_t y, size2_t outputSize, const Settings& settings,
+                                           const std::uint8_t* mask, float* row) const {
+    const vec2 pixelSize = 1.0f / vec2(outputSize);
+    const float nSamples = static_cast<float>(1 + 2 * std::max(settings.nSteps, 0));
+
+    auto renderBatch = [&](const std::array<size_t, lanes>& xs, size_t n) {
+        Lane startX, startY;
+        for (size_t i = 0; i < n; ++i) {
+            startX[i] = (static_cast<float>(xs[i]) + 0.5f) * pixelSize.x;
+            startY[i] = (static_cast<float>(y) + 0.5f) * pixelSize.y;
+        }
+        Lane accVal;
+        sampleLanes(noise_, noiseDims_, startX.data(), startY.data(), n, accVal.data());
+
+        Lane posX, posY, sample;
+        for (const float stepSize : {settings.stepSize, -settings.stepSize}) {
+            posX = startX;
+            posY = startY;
+            for (int s = 0; s < settings.nSteps; ++s) {
+                sampleLanes(noise_, noiseDims_, posX.data(), posY.data(), n, sample.data());
+                for (size_t i = 0; i < n; ++i) accVal[i] += sample[i];
+                step(posX.data(), posY.data(), n, stepSize, settings.integration);
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) row[xs[i]] = accVal[i] / nSamples;
+    };
+
+    std::array<size_t, lanes> xs;
+    size_t n = 0;
+    for (size_t x = 0; x < outputSize.x; ++x) {
+        if (mask && !mask[x]) continue;
+        xs[n++] = x;
+        if (n == lanes) {
+            renderBatch(xs, n);
+            n = 0;
+        }
+    }
+    if (n > 0) renderBatch(xs, n);
+}
+
+void LineIntegralConvolutionCPU::renderBand(size_t y0, size_t y1, size2_t outputSize,
+                                            const Settings& settings, float* output) const {
+    const size_t L = static_cast<size_t>(std::max(settings.nSteps, 0));
+    const size_t M = static_cast<size_t>(std::max(settings.streamlineExtension, 0));
+    const size_t nSide = L + M;
+    const float kernelSize = static_cast<float>(2 * L + 1);
+    const vec2 pixelSize = 1.0f / vec2(outputSize);
+    const size_t bandSize = (y1 - y0) * outputSize.x;
+    constexpr size_t outside = std::numeric_limits<size_t>::max();
+
+    std::vector<float> accVal(bandSize, 0.0f);
+    std::vector<std::uint32_t> hits(bandSize, 0);
+
+    // Streamline point k in [-nSide, nSide] is stored at index k + nSide
+    std::vector<float> samples(2 * nSide + 1);
+    std::vector<size_t> pixels(2 * nSide + 1);
+
+    auto bandIndex = [&](vec2 pos) {
+        if (pos.x < 0.0f || pos.y < 0.0f) return outside;
+        const auto x = static_cast<size_t>(pos.x * outputSize.x);
+        const auto y = static_cast<size_t>(pos.y * outputSize.y);
+        if (x >= outputSize.x || y < y0 || y >= y1) return outside;
+        return x + (y - y0) * outputSize.x;
+    };
+
+    for (size_t seed = 0; seed < bandSize; ++seed) {
+        if (hits[seed] > 0) continue;
+
+        const vec2 start =
+            (vec2(seed % outputSize.x, y0 + seed / outputSize.x) + 0.5f) * pixelSize;
+        samples[nSide] = sampleNoise(start);
+        pixels[nSide] = seed;
+        for (const int dir : {1, -1}) {
+            vec2 pos = start;
+            for (size_t k = 1; k <= nSide; ++k) {
+                pos = step(pos, dir * settings.stepSize, settings.integration);
+                const size_t i = dir > 0 ? nSide + k : nSide - k;
+                samples[i] = sampleNoise(pos);
+                pixels[i] = bandIndex(pos);
+            }
+        }
+
+        auto deposit = [&](size_t i, float sum) {
+            if (pixels[i] == outside) return;
+            accVal[pixels[i]] += sum / kernelSize;
+            ++hits[pixels[i]];
+        };
+
+        float sum = 0.0f;
+        for (size_t i = nSide - L; i <= nSide + L; ++i) sum += samples[i];
+        const float centerSum = sum;
+
+        deposit(nSide, sum);
+        for (size_t i = nSide + 1; i <= nSide + M; ++i) {
+            sum += samples[i + L] - samples[i - L - 1];
+            deposit(i, sum);
+        }
+        sum = centerSum;
+        for (size_t k = 1; k <= M; ++k) {
+            const size_t i = nSide - k;
+            sum += samples[i - L] - samples[i + L + 1];
+            deposit(i, sum);
+        }
+    }
+
+    float* band = output + y0 * outputSize.x;
+    for (size_t i = 0; i < bandSize; ++i) band[i] = accVal[i] / static_cast<float>(hits[i]);
+}
+
+void LineIntegralConvolutionCPU::render(size2_t outputSize, const Settings& settings,
+                                        float* output) const {
+    if (settings.method == Method::FastLIC) {
+        util::parallelRange(outputSize.y, bandHeight, [&](size_t y0, size_t y1) {
+            renderBand(y0, y1, outputSize, settings, output);
+        });
+    } else {
+        util::parallelRange(outputSize.y, 1, [&](size_t y, size_t) {
+            renderRow(y, outputSize, settings, nullptr, output + y * outputSize.x);
+        });
+    }
+}
+
+void LineIntegralConvolutionCPU::render(size2_t outputSize, const Settings& settings,
+                                        const std::vector<std::uint8_t>& mask,
+                                        float* output) const {
+    util::parallelRange(outputSize.y, 1, [&](size_t y, size_t) {
+        renderRow(y, outputSize, settings, mask.data() + y * outputSize.x,
+                  output + y * outputSize.x);
+    });
+}
+
+std::shared_ptr<Image> LineIntegralConvolutionCPU::render(size2_t outputSize,
+                                                          const Settings& settings) const {
+    auto image = std::make_shared<Image>(outputSize, DataFloat32::get());
+    auto layer = static_cast<LayerRAMPrecision<float>*>(
+        image->getColorLayer()->getEditableRepresentation<LayerRAM>());
+    render(outputSize, settings, layer->getDataTyped());
+    return image;
+}
+
+}  // namespace inviwo
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <inviwo/tnm067lab4/tnm067lab4moduledefine.h>
+#include <inviwo/core/util/glm.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace inviwo {
+
+class LayerRAM;
+class Image;
+
+/*
+ * CPU version of lineintegralconvolution.frag for rendering LIC images on machines without a GPU.
+ * `traverse` follows the shader: the noise is sampled at the start position and then at each of
+ * the nSteps positions in both directions along the normalized vector field, with stepSize in
+ * texture coordinates. Both textures are sampled like texture() with linear filtering and
+ * clamp-to-edge, using the bilinear interpolation from Lab1.
+ *
+ * Scanlines are distributed over threads and each scanline is processed in batches of up to eight
+ * pixels stored structure-of-arrays. The texture coordinates, clamped texel indices, interpolation
+ * weights and integration steps are computed as lane arrays so they can be vectorized across
+ * pixels, only the texel lookups are done one lane at a time.
+ *
+ * Method::FastLIC instead follows Stalling and Hege: a streamline is integrated once from a seed
+ * pixel, extended streamlineExtension steps beyond the kernel in both directions, and a running
+ * box filter of 2 * nSteps + 1 samples is slid along it. Every pixel the streamline passes gets the
+ * filter value at that point added, and pixels that already have been hit are not used as seeds.
+ * The result is the average of all hits per pixel. The box filter weighs the start sample once,
+ * the shader counts it three times, so the two methods give slightly different images.
+ */
+class IVW_MODULE_TNM067LAB4_API LineIntegralConvolutionCPU {
+public:
+    enum class Integration { Euler, RK4 };
+    enum class Method { PerPixel, FastLIC };
+
+    struct Settings {
+        int nSteps = 30;
+        float stepSize = 0.003f;
+        Integration integration = Integration::RK4;
+        Method method = Method::PerPixel;
+        // FastLIC only, steps each streamline continues past the kernel in each direction
+        int streamlineExtension = 100;
+    };
+
+    LineIntegralConvolutionCPU(const LayerRAM& vectorField, const LayerRAM& noise);
+    // The field components and the noise as planes of dims.x * dims.y values, x fastest
+    LineIntegralConvolutionCPU(size2_t fieldDims, std::vector<float> fieldX,
+                               std::vector<float> fieldY, size2_t noiseDims,
+                               std::vector<float> noise);
+
+    // Single channel float image with the convolved noise
+    std::shared_ptr<Image> render(size2_t outputSize, const Settings& settings) const;
+    // Write outputSize.x * outputSize.y values, x fastest
+    void render(size2_t outputSize, const Settings& settings, float* output) const;
+    // Only write the pixels where mask is non-zero, always using Method::PerPixel
+    void render(size2_t outputSize, const Settings& settings,
+                const std::vector<std::uint8_t>& mask, float* output) const;
+
+    // Bilinear lookup with clamp-to-edge in a plane of dims.x * dims.y values, like texture()
+    static float sampleLinear(const std::vector<float>& plane, size2_t dims, vec2 texCoord);
+
+    // texture(inport, texCoord).xy
+    vec2 sampleField(vec2 texCoord) const;
+    // texture(noiseTexture, texCoord).r
+    float sampleNoise(vec2 texCoord) const;
+    // normalize(texture(inport, texCoord).xy), zero where the field vanishes
+    vec2 direction(vec2 texCoord) const;
+    // One integration step of length stepSize from pos
+    vec2 step(vec2 pos, float stepSize, Integration integration) const;
+
+private:
+    // direction() for the n positions (x[i], y[i]), n at most the batch size
+    void direction(const float* x, const float* y, size_t n, float* dirX, float* dirY) const;
+    // step() for the n positions (x[i], y[i]), which are updated in place
+    void step(float* x, float* y, size_t n, float stepSize, Integration integration) const;
+
+    // Render the pixels of row y where mask is non-zero, or all of them if mask is null
+    void renderRow(size_t y, size2_t outputSize, const Settings& settings,
+                   const std::uint8_t* mask, float* row) const;
+    // FastLIC for the rows [y0, y1), contributions outside the band are dropped
+    void renderBand(size_t y0, size_t y1, size2_t outputSize, const Settings& settings,
+                    float* output) const;
+
+    size2_t fieldDims_;
+    std::vector<float> fieldX_;
+    std::vector<float> fieldY_;
+    size2_t noiseDims_;
+    std::vector<float> noise_;
+};
+
+}  // namespace inviwo
@@ -0,0 +1,204 @@
+#include <inviwo/tnm067lab4/util/lineintegralconvolutioncpu.h>
+
+#include <warn/push>
+#include <warn/ignore/all>
+#include <gtest/gtest.h>
+#include <warn/pop>
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numbers>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace inviwo {
+
+/*
+ * The reference images in data/ were rendered with a line by line float transcription of main()
+ * and traverse() in lineintegralconvolution.frag, with texture() done as linear filtering with
+ * clamp-to-edge, for the field and noise below, an output of 64x64, nSteps = 15 and
+ * stepSize = 0.01. The Euler image uses the commented out Euler step of traverse. They are stored
+ * as ASCII PGM with 16 bits per pixel and the first row at the top.
+ */
+namespace {
+
+const size2_t fieldDims{32, 32};
+const size2_t noiseDims{64, 64};
+const size2_t outputSize{64, 64};
+
+// Integer hash, so the noise does not depend on the standard library
+std::vector<float> hashNoise() {
+    std::vector<float> noise(noiseDims.x * noiseDims.y);
+    for (std::uint32_t y = 0; y < noiseDims.y; ++y) {
+        for (std::uint32_t x = 0; x < noiseDims.x; ++x) {
+            std::uint32_t h = (x * 73856093u) ^ (y * 19349663u);
+            h ^= h >> 13;
+            h *= 0x5bd1e995u;
+            h ^= h >> 15;
+            noise[x + y * noiseDims.x] = static_cast<float>(h & 0xffffffu) / 16777216.0f;
+        }
+    }
+    return noise;
+}
+
+// The field given as a function of the texture coordinates, sampled at the texel centers
+template <typename Field>
+LineIntegralConvolutionCPU makeEngine(Field field) {
+    std::vector<float> fieldX(fieldDims.x * fieldDims.y);
+    std::vector<float> fieldY(fieldDims.x * fieldDims.y);
+    for (size_t y = 0; y < fieldDims.y; ++y) {
+        for (size_t x = 0; x < fieldDims.x; ++x) {
+            const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(fieldDims.x);
+            const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(fieldDims.y);
+            const vec2 value = field(u, v);
+            fieldX[x + y * fieldDims.x] = value.x;
+            fieldY[x + y * fieldDims.x] = value.y;
+        }
+    }
+    return {fieldDims, std::move(fieldX), std::move(fieldY), noiseDims, hashNoise()};
+}
+
+// Waves along both axes, the x component is at least 0.5 so the field never vanishes
+LineIntegralConvolutionCPU referenceEngine() {
+    constexpr float pi = std::numbers::pi_v<float>;
+    return makeEngine([&](float u, float v) {
+        return vec2{std::cos(2 * pi * v) + 1.5f, std::sin(2 * pi * u)};
+    });
+}
+
+// Values in [0, 1], x fastest and the first value at the bottom like the rendered image
+std::vector<float> readReference(const std::string& name) {
+    const auto file = std::filesystem::path{__FILE__}.parent_path() / "data" / name;
+    std::ifstream in{file};
+    std::string magic;
+    size_t width = 0;
+    size_t height = 0;
+    double maxValue = 0.0;
+    in >> magic >> width >> height >> maxValue;
+    if (!in || magic != "P2" || width != outputSize.x || height != outputSize.y) {
+        ADD_FAILURE() << "Unable to read reference image " << file;
+        return {};
+    }
+
+    std::vector<float> image(width * height);
+    for (size_t row = 0; row < height; ++row) {
+        for (size_t x = 0; x < width; ++x) {
+            double value = 0.0;
+            in >> value;
+            image[x + (height - 1 - row) * width] = static_cast<float>(value / maxValue);
+        }
+    }
+    if (!in) ADD_FAILURE() << "Truncated reference image " << file;
+    return image;
+}
+
+void compareWithReference(LineIntegralConvolutionCPU::Integration integration,
+                          const std::string& reference) {
+    const auto expected = readReference(reference);
+    ASSERT_EQ(expected.size(), outputSize.x * outputSize.y);
+
+    LineIntegralConvolutionCPU::Settings settings;
+    settings.nSteps = 15;
+    settings.stepSize = 0.01f;
+    settings.integration = integration;
+    std::vector<float> result(outputSize.x * outputSize.y);
+    referenceEngine().render(outputSize, settings, result.data());
+
+    // Allows for the 16 bit quantization and rounding differences in the normalization
+    constexpr float tolerance = 1e-4f;
+    for (size_t i = 0; i < result.size(); ++i) {
+        ASSERT_NEAR(result[i], expected[i], tolerance)
+            << "at pixel (" << i % outputSize.x << ", " << i / outputSize.x << ")";
+    }
+}
+
+}  // namespace
+
+TEST(LineIntegralConvolutionCPU, EulerMatchesShaderReference) {
+    compareWithReference(LineIntegralConvolutionCPU::Integration::Euler, "lic-euler.pgm");
+}
+
+TEST(LineIntegralConvolutionCPU, RK4MatchesShaderReference) {
+    compareWithReference(LineIntegralConvolutionCPU::Integration::RK4, "lic-rk4.pgm");
+}
+
+/*
+ * FastLIC deposits the filter at streamline points instead of at the pixel centers and averages
+ * several streamlines per pixel, so it only agrees with PerPixel up to a few percent. The rows
+ * within the kernel reach of a band border, the image borders and the vortex center where the
+ * field vanishes are left out. Unrelated images of this noise differ by about 0.07 on average.
+ */
+TEST(LineIntegralConvolutionCPU, FastLICMatchesPerPixel) {
+    // Rows per FastLIC band in lineintegralconvolutioncpu.cpp
+    constexpr size_t bandHeight = 64;
+    const size2_t size{192, 192};
+
+    const auto engine = makeEngine([](float u, float v) { return vec2{0.5f - v, u - 0.5f}; });
+    LineIntegralConvolutionCPU::Settings settings;
+    settings.nSteps = 10;
+    settings.stepSize = 0.005f;
+    std::vector<float> perPixel(size.x * size.y);
+    engine.render(size, settings, perPixel.data());
+    settings.method = LineIntegralConvolutionCPU::Method::FastLIC;
+    std::vector<float> fastLIC(size.x * size.y);
+    engine.render(size, settings, fastLIC.data());
+
+    const auto reach = static_cast<size_t>(
+        std::ceil(static_cast<float>(settings.nSteps) * settings.stepSize * size.y)) + 1;
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t y = reach; y + reach < size.y; ++y) {
+        const size_t row = y % bandHeight;
+        if (row < reach || row + reach >= bandHeight) continue;
+        for (size_t x = reach; x + reach < size.x; ++x) {
+            const vec2 offset = (vec2(x, y) + 0.5f) - 0.5f * vec2(size);
+            if (glm::length(offset) < static_cast<float>(reach)) continue;
+
+            const float difference = std::abs(fastLIC[x + y * size.x] - perPixel[x + y * size.x]);
+            EXPECT_LT(difference, 0.15f) << "at pixel (" << x << ", " << y << ")";
+            sum += difference;
+            ++count;
+        }
+    }
+    ASSERT_GT(count, 0u);
+    EXPECT_LT(sum / static_cast<double>(count), 0.03);
+}
+
+// Streamlines that leave the image after a few steps, with and without kernel and extension
+TEST(LineIntegralConvolutionCPU, FastLICStreamlinesLeavingTheImage) {
+    const size2_t size{96, 80};
+    const auto engine = makeEngine([](float, float) { return vec2{1.0f, 0.4f}; });
+
+    for (const auto& [nSteps, extension] :
+         std::vector<std::pair<int, int>>{{0, 0}, {0, 20}, {10, 0}, {10, 20}}) {
+        LineIntegralConvolutionCPU::Settings settings;
+        settings.nSteps = nSteps;
+        settings.stepSize = 0.05f;
+        settings.method = LineIntegralConvolutionCPU::Method::FastLIC;
+        settings.streamlineExtension = extension;
+        std::vector<float> result(size.x * size.y, -1.0f);
+        engine.render(size, settings, result.data());
+
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_TRUE(std::isfinite(result[i]) && result[i] >= 0.0f && result[i] <= 1.0f)
+                << "nSteps " << nSteps << ", extension " << extension << ": " << result[i]
+                << " at pixel (" << i % size.x << ", " << i / size.x << ")";
+        }
+
+        // Without kernel and extension every pixel is its own seed and gets the noise at its center
+        if (nSteps == 0 && extension == 0) {
+            settings.method = LineIntegralConvolutionCPU::Method::PerPixel;
+            std::vector<float> perPixel(size.x * size.y);
+            engine.render(size, settings, perPixel.data());
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_NEAR(result[i], perPixel[i], 1e-6f)
+                    << "at pixel (" << i % size.x << ", " << i / size.x << ")";
+            }
+        }
+    }
+}
+
+}  // namespace inviwo
@@ -0,0 +1,195 @@
+#include <inviwo/tnm067lab4/util/timeserieslic.h>
+#include <inviwo/core/util/exception.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace inviwo {
+
+TimeSeriesLIC::TimeSeriesLIC(std::filesystem::path rawFile, size2_t fieldDims, size2_t outputSize,
+                             Settings settings)
+    : rawFile_{std::move(rawFile)}
+    , in_{rawFile_, std::ios::binary}
+    , fieldDims_{fieldDims}
+    , outputSize_{outputSize}
+    , settings_{settings}
+    , frameCount_{0}
+    , random_{settings.seed}
+    , noise_(outputSize.x * outputSize.y)
+    , noiseOffset_(outputSize.x * outputSize.y)
+    , direction_(outputSize.x * outputSize.y)
+    , previous_(outputSize.x * outputSize.y)
+    , mask_(outputSize.x * outputSize.y) {
+
+    if (!in_) {
+        throw Exception(fmt::format("Unable to open '{}'", rawFile_.string()),
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+    if (glm::any(glm::lessThan(fieldDims_, size2_t(1))) ||
+        glm::any(glm::lessThan(outputSize_, size2_t(1)))) {
+        throw Exception("The field and the output need at least one pixel in each direction",
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+    const auto frameBytes = fieldDims_.x * fieldDims_.y * 2 * sizeof(float);
+    const auto bytes = std::filesystem::file_size(rawFile_);
+    if (bytes == 0 || bytes % frameBytes != 0) {
+        throw Exception(fmt::format("'{}' is {} bytes, expected a multiple of {} bytes",
+                                    rawFile_.string(), bytes, frameBytes),
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+    frameCount_ = bytes / frameBytes;
+}
+
+void TimeSeriesLIC::readFrame(std::vector<float>& u, std::vector<float>& v) {
+    const size_t n = fieldDims_.x * fieldDims_.y;
+    std::vector<float> interleaved(2 * n);
+    const auto frameBytes = static_cast<std::streamsize>(interleaved.size() * sizeof(float));
+
+    in_.seekg(static_cast<std::streamoff>(frame_) * frameBytes);
+    in_.read(reinterpret_cast<char*>(interleaved.data()), frameBytes);
+    if (!in_) {
+        throw Exception(fmt::format("Failed reading frame {} of '{}'", frame_, rawFile_.string()),
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+
+    u.resize(n);
+    v.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        u[i] = interleaved[2 * i];
+        v[i] = interleaved[2 * i + 1];
+    }
+}
+
+void TimeSeriesLIC::advect(const std::vector<float>& u, const std::vector<float>& v,
+                           float* output) {
+    const vec2 size{outputSize_};
+    const ivec2 maxPos = ivec2(outputSize_) - 1;
+    std::uniform_real_distribution<float> fresh(0.0f, 1.0f);
+
+    std::vector<float> noise(noise_.size());
+    std::vector<vec2> noiseOffset(noise_.size());
+
+    for (size_t y = 0; y < outputSize_.y; ++y) {
+        for (size_t x = 0; x < outputSize_.x; ++x) {
+            const size_t i = x + y * outputSize_.x;
+            const vec2 center = vec2(x, y) + 0.5f;
+            const vec2 texCoord = center / size;
+            const vec2 velocity{LineIntegralConvolutionCPU::sampleLinear(u, fieldDims_, texCoord),
+                                LineIntegralConvolutionCPU::sampleLinear(v, fieldDims_, texCoord)};
+            const float length = glm::length(velocity);
+            const vec2 direction = length > 0.0f ? velocity / length : vec2(0.0f);
+
+            mask_[i] = glm::length(direction - direction_[i]) > settings_.refreshThreshold;
+            direction_[i] = direction;
+
+            // Where the noise at this pixel was in the previous frame, in pixels
+            const vec2 q = center - settings_.timeStep * velocity * size;
+            output[i] = LineIntegralConvolutionCPU::sampleLinear(previous_, outputSize_, q / size);
+
+            if (q.x < 0.0f || q.y < 0.0f || q.x >= size.x || q.y >= size.y) {
+                noise[i] = fresh(random_);
+                noiseOffset[i] = vec2(0.0f);
+                mask_[i] = 1;
+                continue;
+            }
+
+            // Take the noise particle that ends up closest to the center of this pixel and keep
+            // track of how far off it is
+            const ivec2 near = ivec2(glm::floor(q));
+            const vec2 shifted = q - noiseOffset_[near.x + near.y * outputSize_.x];
+            const ivec2 k = glm::clamp(ivec2(glm::floor(shifted)), ivec2(0), maxPos);
+            const size_t ki = k.x + k.y * outputSize_.x;
+
+            noise[i] = noise_[ki];
+            noiseOffset[i] = glm::clamp(noiseOffset_[ki] + vec2(k) + 0.5f - q, vec2(-0.5f),
+                                        vec2(0.5f));
+        }
+    }
+
+    noise_.swap(noise);
+    noiseOffset_.swap(noiseOffset);
+}
+
+void TimeSeriesLIC::dilateMask(size_t radius) {
+    // Separable maximum filter using running counts of marked pixels in the window
+    auto dilate = [radius](const std::uint8_t* src, std::uint8_t* dst, size_t n, size_t stride) {
+        size_t count = 0;
+        for (size_t i = 0; i < std::min(radius, n); ++i) count += src[i * stride];
+        for (size_t i = 0; i < n; ++i) {
+            if (i + radius < n) count += src[(i + radius) * stride];
+            dst[i * stride] = count > 0;
+            if (i >= radius) count -= src[(i - radius) * stride];
+        }
+    };
+
+    std::vector<std::uint8_t> rows(mask_.size());
+    for (size_t y = 0; y < outputSize_.y; ++y) {
+        const size_t offset = y * outputSize_.x;
+        dilate(mask_.data() + offset, rows.data() + offset, outputSize_.x, 1);
+    }
+    for (size_t x = 0; x < outputSize_.x; ++x) {
+        dilate(rows.data() + x, mask_.data() + x, outputSize_.y, outputSize_.x);
+    }
+}
+
+TimeSeriesLIC::FrameInfo TimeSeriesLIC::renderNextFrame(float* output) {
+    if (!hasNextFrame()) {
+        throw Exception(fmt::format("No frames left in '{}'", rawFile_.string()),
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+
+    std::vector<float> u;
+    std::vector<float> v;
+    readFrame(u, v);
+
+    const size_t nPixels = outputSize_.x * outputSize_.y;
+    const bool fullRefresh = frame_ == 0 || (settings_.fullRefreshInterval > 0 &&
+                                             frame_ % settings_.fullRefreshInterval == 0);
+    if (frame_ == 0) {
+        std::uniform_real_distribution<float> fresh(0.0f, 1.0f);
+        std::generate(noise_.begin(), noise_.end(), [&]() { return fresh(random_); });
+    }
+    // Also updates the directions used to find changes, on the first frame only that matters
+    advect(u, v, output);
+
+    FrameInfo info{frame_, nPixels};
+    const LineIntegralConvolutionCPU lic{fieldDims_, std::move(u), std::move(v), outputSize_,
+                                         noise_};
+    if (fullRefresh) {
+        lic.render(outputSize_, settings_.lic, output);
+    } else {
+        const auto& kernel = settings_.lic;
+        const float reach = std::max(kernel.nSteps, 0) * kernel.stepSize *
+                            static_cast<float>(std::max(outputSize_.x, outputSize_.y));
+        dilateMask(static_cast<size_t>(std::ceil(reach)) + 1);
+        info.refreshedPixels = std::count(mask_.begin(), mask_.end(), std::uint8_t{1});
+        lic.render(outputSize_, settings_.lic, mask_, output);
+    }
+
+    std::copy(output, output + nPixels, previous_.begin());
+    ++frame_;
+    return info;
+}
+
+void TimeSeriesLIC::renderSequence(const std::filesystem::path& outputFile) {
+    std::ofstream out{outputFile, std::ios::binary};
+    if (!out) {
+        throw Exception(fmt::format("Unable to open '{}' for writing", outputFile.string()),
+                        IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+    }
+
+    std::vector<float> image(outputSize_.x * outputSize_.y);
+    const auto imageBytes = static_cast<std::streamsize>(image.size() * sizeof(float));
+    while (hasNextFrame()) {
+        renderNextFrame(image.data());
+        out.write(reinterpret_cast<const char*>(image.data()), imageBytes);
+        if (!out) {
+            throw Exception(fmt::format("Failed writing '{}'", outputFile.string()),
+                            IVW_CONTEXT_CUSTOM("TimeSeriesLIC"));
+        }
+    }
+}
+
+}  // namespace inviwo
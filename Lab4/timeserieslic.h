@@ -0,0 +1,87 @@
+#pragma once
+
+#include <inviwo/tnm067lab4/tnm067lab4moduledefine.h>
+#include <inviwo/tnm067lab4/util/lineintegralconvolutioncpu.h>
+#include <inviwo/core/util/glm.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace inviwo {
+
+/*
+ * LIC for unsteady vector fields stored as a sequence of frames in a raw file. Only the current
+ * frame is kept in memory. Instead of convolving independent noise for each frame, the noise and
+ * the previous LIC image are advected with the current field (semi-Lagrangian, the noise with
+ * nearest neighbour lookups and a per pixel sub-pixel offset so slow flow still moves it, as in
+ * Lagrangian-Eulerian advection). Pixels are only convolved again where the field direction
+ * changed more than refreshThreshold since the last frame, or where new noise flowed in from the
+ * border, dilated by the length of the kernel. Other pixels keep the advected image.
+ *
+ * The advected image drifts slowly from a full convolution where the speed varies along the
+ * streamlines, fullRefreshInterval bounds that drift. Setting it to 0 only convolves every pixel
+ * in the first frame and leaves the drift unbounded.
+ */
+class IVW_MODULE_TNM067LAB4_API TimeSeriesLIC {
+public:
+    struct Settings {
+        LineIntegralConvolutionCPU::Settings lic;
+        // Distance in texture coordinates the noise moves per frame for a vector of length 1
+        float timeStep = 0.01f;
+        // Change in normalized field direction that triggers a recompute of a pixel
+        float refreshThreshold = 0.05f;
+        // Recompute every pixel each n:th frame, 0 for only the first frame
+        size_t fullRefreshInterval = 100;
+        unsigned int seed = 0;
+    };
+
+    struct FrameInfo {
+        size_t frame = 0;
+        size_t refreshedPixels = 0;
+    };
+
+    /*
+     * @param rawFile headerless, native byte order file with consecutive frames of interleaved
+     * 32 bit float vec2 values, x fastest then y
+     * @param fieldDims the number of vectors in each direction of a frame
+     * @param outputSize size of the rendered images and the noise
+     */
+    TimeSeriesLIC(std::filesystem::path rawFile, size2_t fieldDims, size2_t outputSize,
+                  Settings settings);
+
+    size_t frameCount() const { return frameCount_; }
+    bool hasNextFrame() const { return frame_ < frameCount_; }
+
+    // Render the next frame into output, outputSize.x * outputSize.y values, x fastest
+    FrameInfo renderNextFrame(float* output);
+
+    // Render all remaining frames and write them as 32 bit floats to outputFile, replacing it
+    void renderSequence(const std::filesystem::path& outputFile);
+
+private:
+    void readFrame(std::vector<float>& u, std::vector<float>& v);
+    // Advect noise_ and output along the field, mark changed pixels in mask_
+    void advect(const std::vector<float>& u, const std::vector<float>& v, float* output);
+    // Grow the marked regions of mask_ by radius pixels
+    void dilateMask(size_t radius);
+
+    std::filesystem::path rawFile_;
+    std::ifstream in_;
+    size2_t fieldDims_;
+    size2_t outputSize_;
+    Settings settings_;
+    size_t frameCount_;
+    size_t frame_ = 0;
+
+    std::mt19937 random_;
+    std::vector<float> noise_;
+    std::vector<vec2> noiseOffset_;
+    std::vector<vec2> direction_;
+    std::vector<float> previous_;
+    std::vector<std::uint8_t> mask_;
+};
+
+}  // namespace inviwo
@@ -0,0 +1,87 @@
+#include <inviwo/tnm067lab4/util/vectorfieldderivatives.h>
+#include <inviwo/core/datastructures/image/image.h>
+#include <inviwo/core/datastructures/image/layerram.h>
+#include <inviwo/core/datastructures/image/layerramprecision.h>
+#include <inviwo/tnm067lab1/util/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace inviwo {
+
+std::shared_ptr<Image> VectorFieldDerivatives::compute(const LayerRAM& field) {
+    const size2_t dims = field.getDimensions();
+
+    // The components as separate planes with a one pixel clamped border, so the stencil loop
+    // below has no branches and can be vectorized
+    const size_t w = dims.x + 2;
+    const size_t h = dims.y + 2;
+    std::vector<float> u(w * h);
+    std::vector<float> v(w * h);
+    for (size_t y = 0; y < h; ++y) {
+        const size_t fy = std::clamp<size_t>(y, 1, dims.y) - 1;
+        for (size_t x = 0; x < w; ++x) {
+            const size_t fx = std::clamp<size_t>(x, 1, dims.x) - 1;
+            const auto value = field.getAsDVec2(size2_t(fx, fy));
+            u[x + y * w] = static_cast<float>(value.x);
+            v[x + y * w] = static_cast<float>(value.y);
+        }
+    }
+
+    auto image = std::make_shared<Image>(dims, DataVec4Float32::get());
+    image->addColorLayer(std::make_shared<Layer>(dims, DataVec4Float32::get()));
+    auto quantities = static_cast<LayerRAMPrecision<vec4>*>(
+                          image->getColorLayer(0)->getEditableRepresentation<LayerRAM>())
+                          ->getDataTyped();
+    auto jacobian = static_cast<LayerRAMPrecision<vec4>*>(
+                        image->getColorLayer(1)->getEditableRepresentation<LayerRAM>())
+                        ->getDataTyped();
+
+    // (f(x + 1) - f(x - 1)) / (2 / dims)
+    const float sx = static_cast<float>(dims.x) / 2.0f;
+    const float sy = static_cast<float>(dims.y) / 2.0f;
+
+    util::parallelRange(dims.y, 16, [&](size_t y0, size_t y1) {
+        for (size_t y = y0; y < y1; ++y) {
+            // Rows y - 1, y and y + 1 of the padded planes, pixel x is at index x + 1
+            const float* uDown = u.data() + y * w;
+            const float* uMid = uDown + w;
+            const float* uUp = uMid + w;
+            const float* vDown = v.data() + y * w;
+            const float* vMid = vDown + w;
+            const float* vUp = vMid + w;
+            vec4* quantityRow = quantities + y * dims.x;
+            vec4* jacobianRow = jacobian + y * dims.x;
+
+            for (size_t x = 0; x < dims.x; ++x) {
+                const float dudx = (uMid[x + 2] - uMid[x]) * sx;
+                const float dudy = (uUp[x + 1] - uDown[x + 1]) * sy;
+                const float dvdx = (vMid[x + 2] - vMid[x]) * sx;
+                const float dvdy = (vUp[x + 1] - vDown[x + 1]) * sy;
+                const float uc = uMid[x + 1];
+                const float vc = vMid[x + 1];
+
+                quantityRow[x] = vec4(std::sqrt(uc * uc + vc * vc), dudx + dvdy, dudy - dvdx, uc);
+                jacobianRow[x] = vec4(dudx, dudy, dvdx, dvdy);
+            }
+        }
+    });
+
+    return image;
+}
+
+std::shared_ptr<const Image> VectorFieldDerivatives::get(std::shared_ptr<const Layer> field) {
+    if (!derived_ || source_.lock() != field) {
+        derived_ = compute(*field->getRepresentation<LayerRAM>());
+        source_ = field;
+    }
+    return derived_;
+}
+
+void VectorFieldDerivatives::invalidate() {
+    source_.reset();
+    derived_.reset();
+}
+
+}  // namespace inviwo
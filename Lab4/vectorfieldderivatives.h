@@ -0,0 +1,43 @@
+#pragma once
+
+#include <inviwo/tnm067lab4/tnm067lab4moduledefine.h>
+#include <inviwo/core/util/glm.h>
+
+#include <memory>
+
+namespace inviwo {
+
+class Image;
+class Layer;
+class LayerRAM;
+
+/*
+ * CPU version of the quantities in vectorfieldinformation.frag, computed for every pixel of the
+ * vector field in one pass and cached. The result is an image with two vec4 float layers at the
+ * resolution of the field:
+ *   layer 0: (magnitude, divergence, rotation, passThrough)
+ *   layer 1: the Jacobian (du/dx, du/dy, dv/dx, dv/dy)
+ * The derivatives are central differences in texture coordinates with clamp-to-edge, like dVx and
+ * dVy in the shader, and rotation is dVy.x - dVx.y as in the shader.
+ *
+ * get() only recomputes when given another layer than last time, so switching between the
+ * quantities only selects another channel. Call invalidate() if the field is modified in place.
+ */
+class IVW_MODULE_TNM067LAB4_API VectorFieldDerivatives {
+public:
+    enum class Quantity { Magnitude, Divergence, Rotation, PassThrough };
+
+    // The component of layer 0 holding the quantity
+    static constexpr size_t channel(Quantity quantity) { return static_cast<size_t>(quantity); }
+
+    static std::shared_ptr<Image> compute(const LayerRAM& field);
+
+    std::shared_ptr<const Image> get(std::shared_ptr<const Layer> field);
+    void invalidate();
+
+private:
+    std::weak_ptr<const Layer> source_;
+    std::shared_ptr<const Image> derived_;
+};
+
+}  // namespace inviwo